@@ -6,20 +6,58 @@
 #include <sys/stat.h>
 #include <glib/gstdio.h>
 
+typedef struct ThumbnailQueue ThumbnailQueue;
+
 typedef struct
 {
     GtkStack *stack;
     GtkWidget *main_area;
     GtkWidget *sidebar;
+    GFileMonitor *themes_monitor;
+    GCancellable *palette_scan;
+    GtkWidget *thumbnail_stage;
+    ThumbnailQueue *thumbnails;
 } AppWidgets;
 
+// --- Staged startup: present first, initialize the rest on idle ---
+typedef enum
+{
+    STARTUP_STAGE_CSS,
+    STARTUP_STAGE_MONITOR,
+    STARTUP_STAGE_SIDEBAR,
+    STARTUP_STAGE_DETAIL,
+    STARTUP_STAGE_DONE
+} StartupStage;
+
+typedef struct
+{
+    AppWidgets *widgets;
+    GtkWidget *main_box;
+    GtkWidget *startup_area;
+    StartupStage stage;
+    guint idle_id;
+    gboolean first_frame_seen;
+    gboolean sidebar_ready;
+} StartupCtx;
+
+static gboolean measure_startup = FALSE;
+static gchar *repository_url_option = NULL;
+static gint64 startup_begin_time = 0;
+
+static const GOptionEntry app_options[] = {
+    {"measure-startup", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &measure_startup,
+     "Print time to first frame and to an interactive sidebar, then quit", NULL},
+    {"repository", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_STRING, &repository_url_option,
+     "Base URL (file:// or http://) of a theme repository mirror", "URL"},
+    {NULL}};
+
 typedef struct
 {
     char *theme_name;
     char *location;
 } ThemeRow;
 
-GtkWidget *create_theme_metadata_page(const char *theme_name);
+GtkWidget *create_theme_metadata_page(const char *theme_name, const char *location);
 GtkWidget *create_theme_preview_widget();
 
 // --- Helper: Recursively delete a directory, robust version ---
@@ -165,278 +203,2230 @@ static void on_delete_theme_clicked(GtkButton *button, gpointer user_data)
     gtk_widget_show(dialog);
 }
 
-static void
-on_sidebar_row_selected(GtkListBox *box, GtkListBoxRow *row, gpointer user_data)
+// --- Colour palettes: swatches scanned from colour definitions in theme CSS ---
+#define PALETTE_MAX_SWATCHES 6
+#define PALETTE_MAX_DEFINE 256
+#define PALETTE_CACHE_VERSION 2 // bump when extraction changes to force rescans
+
+typedef struct
 {
-    AppWidgets *widgets = user_data;
-    if (!row || !widgets->main_area)
-        return;
-    ThemeRow *data = g_object_get_data(G_OBJECT(row), "theme_row_data");
-    if (!data)
+    gint64 mtime;
+    guint n_colors;
+    GdkRGBA colors[PALETTE_MAX_SWATCHES];
+} ThemePalette;
+
+// Stylesheets scanned per theme, most specific first: earlier definitions win
+static const char *const palette_stylesheets[] = {
+    "gtk-4.0/gtk.css",
+    "gtk-4.0/gtk-contained.css",
+    "gtk-3.0/gtk.css",
+    "gtk-3.0/gtk-contained.css",
+    NULL};
+
+// Accent, background, foreground and view colours under their usual names,
+// as CSS custom properties or @define-color names
+static const char *const palette_roles[][7] = {
+    {"--accent-bg-color", "--accent-color", "accent_bg_color", "accent_color", "theme_selected_bg_color", "selected_bg_color", NULL},
+    {"--window-bg-color", "window_bg_color", "theme_bg_color", "bg_color", NULL},
+    {"--window-fg-color", "window_fg_color", "theme_fg_color", "fg_color", NULL},
+    {"--view-bg-color", "view_bg_color", "theme_base_color", "base_color", NULL},
+};
+
+static GHashTable *palette_cache = NULL; // theme dir -> ThemePalette
+static gboolean palette_cache_dirty = FALSE; // changed since last saved
+static GMutex palette_lock;
+
+static gchar *palette_cache_path(void)
+{
+    return g_build_filename(g_get_user_cache_dir(), "theme-manager", "palettes.ini", NULL);
+}
+
+// Caller holds palette_lock
+static void palette_cache_ensure_loaded(void)
+{
+    if (palette_cache)
         return;
+    palette_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
 
-    GtkWidget *new_view = create_theme_metadata_page(data->theme_name);
-    GtkWidget *parent = gtk_widget_get_parent(widgets->main_area);
-    gtk_box_remove(GTK_BOX(parent), widgets->main_area);
-    widgets->main_area = new_view;
-    gtk_box_append(GTK_BOX(parent), widgets->main_area);
+    GKeyFile *cache = g_key_file_new();
+    gchar *path = palette_cache_path();
+    if (g_key_file_load_from_file(cache, path, G_KEY_FILE_NONE, NULL))
+    {
+        gchar **groups = g_key_file_get_groups(cache, NULL);
+        for (int i = 0; groups[i] != NULL; i++)
+        {
+            if (g_key_file_get_integer(cache, groups[i], "Version", NULL) != PALETTE_CACHE_VERSION)
+                continue;
+            ThemePalette *palette = g_new0(ThemePalette, 1);
+            palette->mtime = g_key_file_get_int64(cache, groups[i], "Mtime", NULL);
+            gchar **colors = g_key_file_get_string_list(cache, groups[i], "Colors", NULL, NULL);
+            for (int j = 0; colors && colors[j] != NULL && palette->n_colors < PALETTE_MAX_SWATCHES; j++)
+            {
+                if (gdk_rgba_parse(&palette->colors[palette->n_colors], colors[j]))
+                    palette->n_colors++;
+            }
+            g_strfreev(colors);
+            g_hash_table_insert(palette_cache, g_strdup(groups[i]), palette);
+        }
+        g_strfreev(groups);
+    }
+    g_free(path);
+    g_key_file_unref(cache);
 }
 
-static GtkWidget *
-create_sidebar(AppWidgets *widgets)
+// Forget themes that are no longer listed; theme_dirs is the full list
+static void palette_cache_prune(GPtrArray *theme_dirs)
 {
-    GtkWidget *listbox = gtk_list_box_new();
-    gtk_list_box_set_selection_mode(GTK_LIST_BOX(listbox), GTK_SELECTION_BROWSE);
+    GHashTable *listed = g_hash_table_new(g_str_hash, g_str_equal);
+    for (guint i = 0; i < theme_dirs->len; i++)
+        g_hash_table_add(listed, g_ptr_array_index(theme_dirs, i));
 
-    GtkCssProvider *css = gtk_css_provider_new();
-    gtk_css_provider_load_from_string(css, ".row.no-hover:hover { background-color: transparent; }");
-    gtk_style_context_add_provider_for_display(gdk_display_get_default(), GTK_STYLE_PROVIDER(css), GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-    g_object_unref(css);
+    g_mutex_lock(&palette_lock);
+    if (palette_cache)
+    {
+        GHashTableIter iter;
+        gpointer key;
+        g_hash_table_iter_init(&iter, palette_cache);
+        while (g_hash_table_iter_next(&iter, &key, NULL))
+        {
+            if (!g_hash_table_contains(listed, key))
+            {
+                g_hash_table_iter_remove(&iter);
+                palette_cache_dirty = TRUE;
+            }
+        }
+    }
+    g_mutex_unlock(&palette_lock);
+    g_hash_table_unref(listed);
+}
 
-    GtkWidget *user_label = gtk_label_new("User Themes");
-    gtk_widget_set_margin_top(user_label, 8);
-    gtk_widget_set_margin_bottom(user_label, 2);
-    gtk_widget_set_halign(user_label, GTK_ALIGN_CENTER);
-    gtk_widget_add_css_class(user_label, "heading");
-    // Use GtkBox to hold label so it's not treated as a selectable row
-    GtkWidget *user_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
-    gtk_box_append(GTK_BOX(user_box), user_label);
-    GtkWidget *user_row = gtk_list_box_row_new();
-    gtk_list_box_row_set_selectable(GTK_LIST_BOX_ROW(user_row), FALSE);
-    gtk_widget_add_css_class(user_row, "no-hover");
-    gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(user_row), user_box);
-    gtk_list_box_append(GTK_LIST_BOX(listbox), user_row);
+// Write the cache out if anything changed; safe to call from worker threads
+static void palette_cache_save(void)
+{
+    g_mutex_lock(&palette_lock);
+    if (!palette_cache || !palette_cache_dirty)
+    {
+        g_mutex_unlock(&palette_lock);
+        return;
+    }
+    GKeyFile *cache = g_key_file_new();
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, palette_cache);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        ThemePalette *palette = value;
+        gchar *colors[PALETTE_MAX_SWATCHES + 1] = {NULL};
+        for (guint i = 0; i < palette->n_colors; i++)
+            colors[i] = gdk_rgba_to_string(&palette->colors[i]);
+        g_key_file_set_integer(cache, key, "Version", PALETTE_CACHE_VERSION);
+        g_key_file_set_int64(cache, key, "Mtime", palette->mtime);
+        g_key_file_set_string_list(cache, key, "Colors", (const gchar *const *)colors, palette->n_colors);
+        for (guint i = 0; i < palette->n_colors; i++)
+            g_free(colors[i]);
+    }
+    palette_cache_dirty = FALSE;
+    g_mutex_unlock(&palette_lock);
+
+    gchar *path = palette_cache_path();
+    gchar *dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0755);
+    g_key_file_save_to_file(cache, path, NULL);
+    g_free(dir);
+    g_free(path);
+    g_key_file_unref(cache);
+}
 
-    gchar *theme_manager_path = g_build_filename(g_get_home_dir(), ".themes", NULL);
-    GDir *dir = g_dir_open(theme_manager_path, 0, NULL);
-    GList *user_theme_list = NULL;
-    const gchar *filename;
-    if (dir)
+// Newest mtime among the theme's stylesheets, or -1 if it has none
+static gint64 palette_stylesheets_mtime(const char *theme_dir)
+{
+    gint64 mtime = -1;
+    for (int i = 0; palette_stylesheets[i] != NULL; i++)
     {
-        while ((filename = g_dir_read_name(dir)) != NULL)
+        gchar *path = g_build_filename(theme_dir, palette_stylesheets[i], NULL);
+        GStatBuf st;
+        if (g_stat(path, &st) == 0)
+            mtime = MAX(mtime, (gint64)st.st_mtime);
+        g_free(path);
+    }
+    return mtime;
+}
+
+static void palette_add_define(GString *define, GHashTable *defines, GPtrArray *order)
+{
+    gchar *text = g_strstrip(define->str);
+    gsize name_len = strcspn(text, " \t\r\n");
+    if (name_len == 0 || text[name_len] == '\0')
+        return;
+    gchar *name = g_strndup(text, name_len);
+    if (g_hash_table_contains(defines, name))
+    {
+        g_free(name);
+        return;
+    }
+    g_hash_table_insert(defines, name, g_strdup(g_strstrip(text + name_len)));
+    g_ptr_array_add(order, name);
+}
+
+// Collect "@define-color name value;" and "--name: value;" in one streaming
+// pass, skipping comments, so large compiled stylesheets are never held in
+// memory. Custom properties keep their leading dashes as the name.
+static void palette_scan_stylesheet(const char *path, GHashTable *defines, GPtrArray *order)
+{
+    static const char keyword[] = "@define-color";
+    enum
+    {
+        SCAN_TEXT,
+        SCAN_SLASH,
+        SCAN_COMMENT,
+        SCAN_COMMENT_STAR,
+        SCAN_KEYWORD,
+        SCAN_DASH,
+        SCAN_PROPERTY,
+        SCAN_DEFINE
+    } state = SCAN_TEXT;
+
+    FILE *file = g_fopen(path, "rb");
+    if (!file)
+        return;
+
+    char *buffer = g_malloc(65536);
+    GString *define = g_string_sized_new(64);
+    gsize keyword_pos = 0;
+    size_t n;
+    while ((n = fread(buffer, 1, 65536, file)) > 0)
+    {
+        for (size_t i = 0; i < n; i++)
         {
-            gchar *theme_dir = g_build_filename(theme_manager_path, filename, NULL);
-            gchar *index_file = g_build_filename(theme_dir, "index.theme", NULL);
-            if (g_file_test(theme_dir, G_FILE_TEST_IS_DIR) && g_file_test(index_file, G_FILE_TEST_EXISTS))
+            char c = buffer[i];
+            switch (state)
             {
-                user_theme_list = g_list_prepend(user_theme_list, g_strdup(filename));
+            case SCAN_TEXT:
+                while (i < n && buffer[i] != '@' && buffer[i] != '/' && buffer[i] != '-')
+                    i++;
+                if (i == n)
+                    break;
+                c = buffer[i];
+                if (c == '/')
+                    state = SCAN_SLASH;
+                else if (c == '-')
+                    state = SCAN_DASH;
+                else
+                {
+                    state = SCAN_KEYWORD;
+                    keyword_pos = 1;
+                }
+                break;
+            case SCAN_SLASH:
+                state = c == '*' ? SCAN_COMMENT : SCAN_TEXT;
+                if (state == SCAN_TEXT)
+                    i--;
+                break;
+            case SCAN_COMMENT:
+                if (c == '*')
+                    state = SCAN_COMMENT_STAR;
+                break;
+            case SCAN_COMMENT_STAR:
+                if (c == '/')
+                    state = SCAN_TEXT;
+                else if (c != '*')
+                    state = SCAN_COMMENT;
+                break;
+            case SCAN_KEYWORD:
+                if (c == keyword[keyword_pos])
+                {
+                    if (++keyword_pos == sizeof(keyword) - 1)
+                    {
+                        state = SCAN_DEFINE;
+                        g_string_truncate(define, 0);
+                    }
+                }
+                else
+                {
+                    state = SCAN_TEXT;
+                    i--;
+                }
+                break;
+            case SCAN_DASH:
+                if (c == '-')
+                {
+                    state = SCAN_PROPERTY;
+                    g_string_assign(define, "--");
+                }
+                else
+                {
+                    state = SCAN_TEXT;
+                    i--;
+                }
+                break;
+            case SCAN_PROPERTY:
+                // Only "--name:" starts a declaration; var(--name) does not
+                if (c == ':')
+                {
+                    state = SCAN_DEFINE;
+                    g_string_append_c(define, ' ');
+                }
+                else if ((g_ascii_isalnum(c) || c == '-' || c == '_') && define->len < PALETTE_MAX_DEFINE)
+                {
+                    g_string_append_c(define, c);
+                }
+                else
+                {
+                    state = SCAN_TEXT;
+                    i--;
+                }
+                break;
+            case SCAN_DEFINE:
+                // The last declaration in a block may omit its semicolon
+                if (c == ';' || (c == '}' && define->str[0] == '-'))
+                {
+                    palette_add_define(define, defines, order);
+                    state = SCAN_TEXT;
+                }
+                else if (c == '{' || c == '}' || define->len >= PALETTE_MAX_DEFINE)
+                {
+                    state = SCAN_TEXT;
+                }
+                else
+                {
+                    g_string_append_c(define, c);
+                }
+                break;
             }
-            g_free(theme_dir);
-            g_free(index_file);
         }
-        user_theme_list = g_list_sort(user_theme_list, (GCompareFunc)g_ascii_strcasecmp);
-        for (GList *l = user_theme_list; l != NULL; l = l->next)
+    }
+
+    g_string_free(define, TRUE);
+    g_free(buffer);
+    fclose(file);
+}
+
+// Follow @name and var(--name) references; mix()/shade() expressions and
+// var() fallbacks are not evaluated
+static gboolean palette_resolve(GHashTable *defines, const char *name, GdkRGBA *out)
+{
+    const char *value = g_hash_table_lookup(defines, name);
+    gchar *reference = NULL;
+    gboolean resolved = FALSE;
+    for (int depth = 0; value && depth < 8; depth++)
+    {
+        if (value[0] == '@')
         {
-            GtkWidget *row = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
-            GtkWidget *name_label = gtk_label_new((gchar *)l->data);
-            gtk_widget_set_halign(name_label, GTK_ALIGN_CENTER);
-            GtkWidget *loc_label = gtk_label_new(theme_manager_path);
-            gtk_widget_set_halign(loc_label, GTK_ALIGN_CENTER);
-            gtk_widget_add_css_class(loc_label, "dim-label");
-            gtk_box_append(GTK_BOX(row), name_label);
-            gtk_box_append(GTK_BOX(row), loc_label);
-            GtkWidget *list_row = gtk_list_box_row_new();
-            gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(list_row), row);
-            ThemeRow *data = g_new0(ThemeRow, 1);
-            data->theme_name = g_strdup((gchar *)l->data);
-            data->location = g_strdup(theme_manager_path);
-            g_object_set_data_full(G_OBJECT(list_row), "theme_row_data", data, (GDestroyNotify)g_free);
-            // Highlight the currently active theme
-            if (g_strcmp0(data->theme_name, "Currently Active Theme Name") == 0)
+            value = g_hash_table_lookup(defines, value + 1);
+        }
+        else if (g_str_has_prefix(value, "var("))
+        {
+            const char *start = value + 4 + strspn(value + 4, " \t");
+            g_free(reference);
+            reference = g_strndup(start, strcspn(start, ",) \t"));
+            value = g_hash_table_lookup(defines, reference);
+        }
+        else
+        {
+            resolved = gdk_rgba_parse(out, value);
+            break;
+        }
+    }
+    g_free(reference);
+    return resolved;
+}
+
+static gboolean palette_add_color(ThemePalette *palette, const GdkRGBA *color)
+{
+    if (palette->n_colors >= PALETTE_MAX_SWATCHES)
+        return FALSE;
+    for (guint i = 0; i < palette->n_colors; i++)
+    {
+        if (gdk_rgba_equal(&palette->colors[i], color))
+            return FALSE;
+    }
+    palette->colors[palette->n_colors++] = *color;
+    return TRUE;
+}
+
+static void palette_extract(const char *theme_dir, ThemePalette *palette)
+{
+    GHashTable *defines = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    GPtrArray *order = g_ptr_array_new();
+    for (int i = 0; palette_stylesheets[i] != NULL; i++)
+    {
+        gchar *path = g_build_filename(theme_dir, palette_stylesheets[i], NULL);
+        palette_scan_stylesheet(path, defines, order);
+        g_free(path);
+    }
+
+    GdkRGBA color;
+    palette->n_colors = 0;
+    for (guint role = 0; role < G_N_ELEMENTS(palette_roles); role++)
+    {
+        for (int j = 0; palette_roles[role][j] != NULL; j++)
+        {
+            if (palette_resolve(defines, palette_roles[role][j], &color))
             {
-                gtk_widget_add_css_class(list_row, "active-theme");
+                palette_add_color(palette, &color);
+                break;
             }
-            gtk_list_box_append(GTK_LIST_BOX(listbox), list_row);
-            g_free(l->data);
         }
-        g_list_free(user_theme_list);
     }
-    g_free(theme_manager_path);
-    g_dir_close(dir);
+    // Fill the remaining slots with whatever else the theme defines
+    for (guint i = 0; i < order->len && palette->n_colors < PALETTE_MAX_SWATCHES; i++)
+    {
+        if (palette_resolve(defines, g_ptr_array_index(order, i), &color))
+            palette_add_color(palette, &color);
+    }
 
-    GtkWidget *sep = gtk_separator_new(GTK_ORIENTATION_HORIZONTAL);
-    gtk_list_box_append(GTK_LIST_BOX(listbox), sep);
-    GtkWidget *sep_row = gtk_widget_get_parent(sep);
-    gtk_list_box_row_set_selectable(GTK_LIST_BOX_ROW(sep_row), FALSE);
+    g_ptr_array_free(order, TRUE);
+    g_hash_table_unref(defines);
+}
 
-    GtkWidget *sys_label = gtk_label_new("System Themes");
-    gtk_widget_set_margin_top(sys_label, 8);
-    gtk_widget_set_margin_bottom(sys_label, 2);
-    gtk_widget_set_halign(sys_label, GTK_ALIGN_CENTER);
-    gtk_widget_add_css_class(sys_label, "heading");
-    // Use GtkBox to hold label so it's not treated as a selectable row
-    GtkWidget *sys_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
-    gtk_box_append(GTK_BOX(sys_box), sys_label);
-    GtkWidget *sys_row = gtk_list_box_row_new();
-    gtk_list_box_row_set_selectable(GTK_LIST_BOX_ROW(sys_row), FALSE);
-    gtk_widget_add_css_class(sys_row, "no-hover");
-    gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(sys_row), sys_box);
-    gtk_list_box_append(GTK_LIST_BOX(listbox), sys_row);
+// Cached palette only, no disk access; suitable for draw handlers
+static gboolean theme_palette_get(const char *theme_dir, ThemePalette *out)
+{
+    g_mutex_lock(&palette_lock);
+    palette_cache_ensure_loaded();
+    ThemePalette *palette = g_hash_table_lookup(palette_cache, theme_dir);
+    gboolean found = palette != NULL;
+    if (found)
+        *out = *palette;
+    g_mutex_unlock(&palette_lock);
+    // The entry may be replaced by a scan as soon as the lock is released
+    return found && out->n_colors > 0;
+}
+
+// Rescan the theme's stylesheets if they changed since the cached copy.
+// Safe to call from worker threads.
+static gboolean theme_palette_update(const char *theme_dir, ThemePalette *out)
+{
+    gint64 mtime = palette_stylesheets_mtime(theme_dir);
+
+    g_mutex_lock(&palette_lock);
+    palette_cache_ensure_loaded();
+    ThemePalette *cached = g_hash_table_lookup(palette_cache, theme_dir);
+    gboolean fresh = cached && cached->mtime == mtime;
+    if (fresh)
+        *out = *cached;
+    g_mutex_unlock(&palette_lock);
+    if (fresh)
+        return out->n_colors > 0;
+
+    ThemePalette *palette = g_new0(ThemePalette, 1);
+    palette->mtime = mtime;
+    if (mtime >= 0)
+        palette_extract(theme_dir, palette);
+    *out = *palette;
+
+    g_mutex_lock(&palette_lock);
+    g_hash_table_replace(palette_cache, g_strdup(theme_dir), palette);
+    palette_cache_dirty = TRUE;
+    g_mutex_unlock(&palette_lock);
+    return out->n_colors > 0;
+}
+
+static void palette_swatches_draw(GtkDrawingArea *area, cairo_t *cr, int width, int height, gpointer user_data)
+{
+    ThemePalette palette;
+    if (!theme_palette_get(user_data, &palette))
+        return;
+
+    double radius = height / 2.0 - 1.0;
+    double step = height + 4.0;
+    double x = (width - (palette.n_colors * step - 4.0)) / 2.0 + height / 2.0;
+    for (guint i = 0; i < palette.n_colors; i++, x += step)
+    {
+        cairo_arc(cr, x, height / 2.0, radius, 0, 2 * G_PI);
+        gdk_cairo_set_source_rgba(cr, &palette.colors[i]);
+        cairo_fill_preserve(cr);
+        cairo_set_source_rgba(cr, 0, 0, 0, 0.25);
+        cairo_set_line_width(cr, 1.0);
+        cairo_stroke(cr);
+    }
+}
+
+static GtkWidget *create_palette_swatches(const char *theme_dir, int size)
+{
+    GtkWidget *area = gtk_drawing_area_new();
+    gtk_drawing_area_set_content_width(GTK_DRAWING_AREA(area), PALETTE_MAX_SWATCHES * (size + 4));
+    gtk_drawing_area_set_content_height(GTK_DRAWING_AREA(area), size);
+    gtk_drawing_area_set_draw_func(GTK_DRAWING_AREA(area), palette_swatches_draw, g_strdup(theme_dir), g_free);
+    gtk_widget_set_halign(area, GTK_ALIGN_CENTER);
+    return area;
+}
+
+// --- Theme thumbnails: the theme's own CSS on real widgets, cached as PNG ---
+//
+// A small widget set gets the theme's gtk.css attached to each of its
+// widgets, is laid out and drawn inside a 1px clipping host in the main
+// window, and its render node is rendered to a texture with the Cairo
+// (software) renderer. Cache lookups and PNG encoding run on workers.
+#define THUMBNAIL_WIDTH 120
+#define THUMBNAIL_HEIGHT 72
+#define THUMBNAIL_LAYOUT_SCALE 2.5 // the widget set is laid out at 300x180
+#define THUMBNAIL_SCROLL_PAUSE_MS 300
+
+static const char *const thumbnail_stylesheets[] = {
+    "gtk-4.0/gtk.css",
+    "gtk-3.0/gtk.css",
+    NULL};
+
+typedef struct
+{
+    gchar *theme_dir;
+    gchar *stylesheet; // NULL if the theme ships no GTK CSS
+    gchar *cache_path;
+    GdkTexture *texture; // cached thumbnail, if there is one
+} ThumbnailLookup;
+
+// Owned by AppWidgets and replaced with each sidebar; holds refs on the
+// listbox and rows so nothing it touches can go away underneath it
+struct ThumbnailQueue
+{
+    AppWidgets *widgets;
+    GtkWidget *listbox;
+    GList *pending; // list rows still waiting for a thumbnail
+    GtkWidget *current_row;
+    ThumbnailLookup *lookup;
+    GtkWidget *specimen;
+    GdkFrameClock *clock;
+    gulong paint_handler;
+    int paint_attempts;
+    guint idle_id;
+    GtkAdjustment *vadjustment;
+    gulong scroll_handler;
+    guint resume_id; // pending while the sidebar is being scrolled
+    GCancellable *cancellable;
+};
+
+typedef struct
+{
+    GdkTexture *texture;
+    gchar *path;
+} ThumbnailSave;
+
+static GskRenderer *thumbnail_renderer = NULL;
+
+static gboolean thumbnail_queue_step(gpointer user_data);
+
+static gchar *thumbnail_cache_dir(void)
+{
+    return g_build_filename(g_get_user_cache_dir(), "theme-manager", "thumbnails", NULL);
+}
+
+// Keyed by theme path and stylesheet mtime, so edits get a new thumbnail;
+// the path digest prefix lets older thumbnails of the theme be found
+static gchar *thumbnail_cache_path(const char *theme_dir, gint64 mtime)
+{
+    gchar *digest = g_compute_checksum_for_string(G_CHECKSUM_MD5, theme_dir, -1);
+    gchar *name = g_strdup_printf("%s-%" G_GINT64_FORMAT ".png", digest, mtime);
+    gchar *dir = thumbnail_cache_dir();
+    gchar *path = g_build_filename(dir, name, NULL);
+    g_free(dir);
+    g_free(name);
+    g_free(digest);
+    return path;
+}
+
+static void thumbnail_lookup_free(ThumbnailLookup *lookup)
+{
+    g_free(lookup->theme_dir);
+    g_free(lookup->stylesheet);
+    g_free(lookup->cache_path);
+    g_clear_object(&lookup->texture);
+    g_free(lookup);
+}
+
+static void thumbnail_lookup_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable)
+{
+    ThumbnailLookup *lookup = task_data;
+    for (int i = 0; thumbnail_stylesheets[i] != NULL && !lookup->stylesheet; i++)
+    {
+        gchar *path = g_build_filename(lookup->theme_dir, thumbnail_stylesheets[i], NULL);
+        if (g_file_test(path, G_FILE_TEST_IS_REGULAR))
+            lookup->stylesheet = path;
+        else
+            g_free(path);
+    }
+    if (lookup->stylesheet)
+    {
+        lookup->cache_path = thumbnail_cache_path(lookup->theme_dir, palette_stylesheets_mtime(lookup->theme_dir));
+        if (g_file_test(lookup->cache_path, G_FILE_TEST_EXISTS))
+            lookup->texture = gdk_texture_new_from_filename(lookup->cache_path, NULL);
+    }
+    g_task_return_boolean(task, TRUE);
+}
+
+// Delete the cached PNGs whose digest prefix is in digests (keep == FALSE)
+// or is not in it (keep == TRUE); except is a file name to leave alone
+static void thumbnail_prune(GHashTable *digests, gboolean keep, const char *except)
+{
+    gchar *dir_path = thumbnail_cache_dir();
+    GDir *dir = g_dir_open(dir_path, 0, NULL);
+    const gchar *name;
+    while (dir && (name = g_dir_read_name(dir)) != NULL)
+    {
+        const char *dash = strchr(name, '-');
+        if (!dash || g_strcmp0(name, except) == 0)
+            continue;
+        gchar *digest = g_strndup(name, dash - name);
+        if (g_hash_table_contains(digests, digest) != keep)
+        {
+            gchar *path = g_build_filename(dir_path, name, NULL);
+            g_remove(path);
+            g_free(path);
+        }
+        g_free(digest);
+    }
+    if (dir)
+        g_dir_close(dir);
+    g_free(dir_path);
+}
+
+static void thumbnail_save_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable)
+{
+    ThumbnailSave *save = task_data;
+    gchar *dir = g_path_get_dirname(save->path);
+    g_mkdir_with_parents(dir, 0755);
+    g_free(dir);
+    if (gdk_texture_save_to_png(save->texture, save->path))
+    {
+        // Older thumbnails of the same theme are stale now
+        gchar *name = g_path_get_basename(save->path);
+        GHashTable *digests = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        g_hash_table_add(digests, g_strndup(name, strcspn(name, "-")));
+        thumbnail_prune(digests, FALSE, name);
+        g_hash_table_unref(digests);
+        g_free(name);
+    }
+    g_task_return_boolean(task, TRUE);
+}
+
+static void thumbnail_save_free(gpointer data)
+{
+    ThumbnailSave *save = data;
+    g_object_unref(save->texture);
+    g_free(save->path);
+    g_free(save);
+}
+
+static void thumbnail_save_async(GdkTexture *texture, const char *path)
+{
+    ThumbnailSave *save = g_new0(ThumbnailSave, 1);
+    save->texture = g_object_ref(texture);
+    save->path = g_strdup(path);
+    GTask *task = g_task_new(NULL, NULL, NULL, NULL);
+    g_task_set_task_data(task, save, thumbnail_save_free);
+    g_task_run_in_thread(task, thumbnail_save_thread);
+    g_object_unref(task);
+}
+
+static void thumbnail_prune_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable)
+{
+    thumbnail_prune(task_data, TRUE, NULL);
+    g_task_return_boolean(task, TRUE);
+}
+
+// Window with header bar, a label, an entry, a check button, a switch, a
+// suggested-action button and a progress bar
+static GtkWidget *thumbnail_build_specimen(void)
+{
+    GtkWidget *window_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+    gtk_widget_add_css_class(window_box, "background");
+    gtk_widget_set_size_request(window_box, THUMBNAIL_WIDTH * THUMBNAIL_LAYOUT_SCALE, THUMBNAIL_HEIGHT * THUMBNAIL_LAYOUT_SCALE);
+
+    GtkWidget *header = gtk_header_bar_new();
+    gtk_header_bar_set_show_title_buttons(GTK_HEADER_BAR(header), FALSE);
+    GtkWidget *title = gtk_label_new("Theme Preview");
+    gtk_widget_add_css_class(title, "title");
+    gtk_header_bar_set_title_widget(GTK_HEADER_BAR(header), title);
+    gtk_box_append(GTK_BOX(window_box), header);
+
+    GtkWidget *content = gtk_box_new(GTK_ORIENTATION_VERTICAL, 8);
+    gtk_widget_set_margin_top(content, 12);
+    gtk_widget_set_margin_bottom(content, 12);
+    gtk_widget_set_margin_start(content, 12);
+    gtk_widget_set_margin_end(content, 12);
+    gtk_widget_set_vexpand(content, TRUE);
+    gtk_box_append(GTK_BOX(window_box), content);
+
+    GtkWidget *label = gtk_label_new("The quick brown fox");
+    gtk_label_set_xalign(GTK_LABEL(label), 0.0f);
+    gtk_box_append(GTK_BOX(content), label);
+
+    GtkWidget *entry = gtk_entry_new();
+    gtk_editable_set_text(GTK_EDITABLE(entry), "Text entry");
+    gtk_box_append(GTK_BOX(content), entry);
+
+    GtkWidget *controls = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+    GtkWidget *check = gtk_check_button_new_with_label("Check");
+    gtk_check_button_set_active(GTK_CHECK_BUTTON(check), TRUE);
+    GtkWidget *toggle = gtk_switch_new();
+    gtk_switch_set_active(GTK_SWITCH(toggle), TRUE);
+    gtk_widget_set_valign(toggle, GTK_ALIGN_CENTER);
+    GtkWidget *button = gtk_button_new_with_label("Apply");
+    gtk_widget_add_css_class(button, "suggested-action");
+    gtk_widget_set_hexpand(button, TRUE);
+    gtk_widget_set_halign(button, GTK_ALIGN_END);
+    gtk_box_append(GTK_BOX(controls), check);
+    gtk_box_append(GTK_BOX(controls), toggle);
+    gtk_box_append(GTK_BOX(controls), button);
+    gtk_box_append(GTK_BOX(content), controls);
+
+    GtkWidget *progress = gtk_progress_bar_new();
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(progress), 0.6);
+    gtk_box_append(GTK_BOX(content), progress);
+
+    return window_box;
+}
+
+// Per-widget providers only match their own widget, so walk the whole tree
+// including internal children; USER priority beats our application CSS
+static void thumbnail_apply_provider(GtkWidget *widget, GtkStyleProvider *provider)
+{
+    G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+    gtk_style_context_add_provider(gtk_widget_get_style_context(widget), provider, GTK_STYLE_PROVIDER_PRIORITY_USER);
+    G_GNUC_END_IGNORE_DEPRECATIONS
+    for (GtkWidget *child = gtk_widget_get_first_child(widget); child != NULL; child = gtk_widget_get_next_sibling(child))
+        thumbnail_apply_provider(child, provider);
+}
+
+// Themes written for other GTK versions are full of unknown properties
+static void thumbnail_ignore_parsing_error(GtkCssProvider *provider, GtkCssSection *section, GError *error, gpointer user_data)
+{
+}
+
+// A 1px scrolled window in the main view: widgets inside it are laid out
+// and drawn with every frame, but clipped so nothing reaches the screen
+static GtkWidget *thumbnail_get_stage(AppWidgets *widgets)
+{
+    if (widgets->thumbnail_stage)
+        return widgets->thumbnail_stage;
+    GtkWidget *main_view_box = widgets->main_area ? gtk_widget_get_parent(widgets->main_area) : NULL;
+    if (!main_view_box)
+        return NULL;
+
+    GtkWidget *host = gtk_scrolled_window_new();
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(host), GTK_POLICY_EXTERNAL, GTK_POLICY_EXTERNAL);
+    gtk_widget_set_size_request(host, 1, 1);
+    gtk_widget_set_can_target(host, FALSE);
+    gtk_widget_set_can_focus(host, FALSE);
+    widgets->thumbnail_stage = gtk_fixed_new();
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(host), widgets->thumbnail_stage);
+    gtk_box_append(GTK_BOX(main_view_box), host);
+    return widgets->thumbnail_stage;
+}
+
+static GskRenderer *thumbnail_get_renderer(void)
+{
+    if (thumbnail_renderer)
+        return thumbnail_renderer;
+
+    GError *error = NULL;
+    thumbnail_renderer = gsk_cairo_renderer_new();
+#if GTK_CHECK_VERSION(4, 14, 0)
+    gboolean realized = gsk_renderer_realize_for_display(thumbnail_renderer, gdk_display_get_default(), &error);
+#else
+    gboolean realized = gsk_renderer_realize(thumbnail_renderer, NULL, &error);
+#endif
+    if (!realized)
+    {
+        g_print("Failed to set up thumbnail renderer: %s\n", error->message);
+        g_error_free(error);
+        g_clear_object(&thumbnail_renderer);
+    }
+    return thumbnail_renderer;
+}
+
+// Render what the last frame drew for the specimen, scaled to fit
+static GdkTexture *thumbnail_render(GtkWidget *specimen)
+{
+    int width = gtk_widget_get_width(specimen);
+    int height = gtk_widget_get_height(specimen);
+    GskRenderer *renderer = thumbnail_get_renderer();
+    if (width <= 0 || height <= 0 || !renderer)
+        return NULL;
+
+    double scale = MIN((double)THUMBNAIL_WIDTH / width, (double)THUMBNAIL_HEIGHT / height);
+    GdkPaintable *paintable = gtk_widget_paintable_new(specimen);
+    GtkSnapshot *snapshot = gtk_snapshot_new();
+    gdk_paintable_snapshot(paintable, snapshot, width * scale, height * scale);
+    GskRenderNode *node = gtk_snapshot_free_to_node(snapshot);
+    g_object_unref(paintable);
+    if (!node)
+        return NULL;
+
+    GdkTexture *texture = gsk_renderer_render_texture(renderer, node, &GRAPHENE_RECT_INIT(0, 0, width * scale, height * scale));
+    gsk_render_node_unref(node);
+    return texture;
+}
+
+static void thumbnail_queue_schedule(ThumbnailQueue *queue)
+{
+    if (queue->pending && !queue->current_row && !queue->idle_id && !queue->resume_id)
+        queue->idle_id = g_idle_add_full(G_PRIORITY_LOW, thumbnail_queue_step, queue, NULL);
+}
+
+static void thumbnail_queue_next(ThumbnailQueue *queue)
+{
+    g_clear_object(&queue->current_row);
+    thumbnail_queue_schedule(queue);
+}
+
+static gboolean thumbnail_queue_resume(gpointer user_data)
+{
+    ThumbnailQueue *queue = user_data;
+    queue->resume_id = 0;
+    thumbnail_queue_schedule(queue);
+    return G_SOURCE_REMOVE;
+}
+
+// The theme's CSS has to be parsed and applied on the main thread, which
+// takes tens of ms for a compiled theme, so nothing new starts until the
+// sidebar has stopped scrolling for a moment
+static void thumbnail_on_scroll(GtkAdjustment *adjustment, gpointer user_data)
+{
+    ThumbnailQueue *queue = user_data;
+    if (queue->idle_id)
+    {
+        g_source_remove(queue->idle_id);
+        queue->idle_id = 0;
+    }
+    if (queue->resume_id)
+        g_source_remove(queue->resume_id);
+    queue->resume_id = g_timeout_add(THUMBNAIL_SCROLL_PAUSE_MS, thumbnail_queue_resume, queue);
+}
+
+static void thumbnail_discard_specimen(ThumbnailQueue *queue)
+{
+    if (queue->paint_handler)
+    {
+        g_signal_handler_disconnect(queue->clock, queue->paint_handler);
+        queue->paint_handler = 0;
+    }
+    g_clear_object(&queue->clock);
+    if (queue->specimen)
+    {
+        GtkWidget *stage = gtk_widget_get_parent(queue->specimen);
+        if (stage)
+            gtk_fixed_remove(GTK_FIXED(stage), queue->specimen);
+        g_clear_object(&queue->specimen);
+    }
+}
+
+static void thumbnail_after_paint(GdkFrameClock *clock, gpointer user_data)
+{
+    ThumbnailQueue *queue = user_data;
+    if (gtk_widget_get_width(queue->specimen) <= 0 && ++queue->paint_attempts < 3)
+    {
+        // Not laid out in this frame yet, wait for the next one
+        gtk_widget_queue_draw(queue->specimen);
+        return;
+    }
+
+    GtkWidget *picture = g_object_get_data(G_OBJECT(queue->current_row), "thumbnail");
+    GdkTexture *texture = thumbnail_render(queue->specimen);
+    thumbnail_discard_specimen(queue);
+    if (texture)
+    {
+        gtk_picture_set_paintable(GTK_PICTURE(picture), GDK_PAINTABLE(texture));
+        thumbnail_save_async(texture, queue->lookup->cache_path);
+        g_object_unref(texture);
+    }
+    else
+    {
+        gtk_widget_set_visible(picture, FALSE);
+    }
+    thumbnail_lookup_free(queue->lookup);
+    queue->lookup = NULL;
+    thumbnail_queue_next(queue);
+}
+
+static void thumbnail_render_begin(ThumbnailQueue *queue)
+{
+    GtkWidget *stage = thumbnail_get_stage(queue->widgets);
+    GdkFrameClock *clock = stage ? gtk_widget_get_frame_clock(stage) : NULL;
+    if (!clock)
+    {
+        // Not on screen yet; try this row again later
+        queue->pending = g_list_append(queue->pending, queue->current_row);
+        queue->current_row = NULL;
+        thumbnail_lookup_free(queue->lookup);
+        queue->lookup = NULL;
+        if (!queue->idle_id)
+            queue->idle_id = g_timeout_add_full(G_PRIORITY_LOW, 500, thumbnail_queue_step, queue, NULL);
+        return;
+    }
+
+    GtkCssProvider *provider = gtk_css_provider_new();
+    g_signal_connect(provider, "parsing-error", G_CALLBACK(thumbnail_ignore_parsing_error), NULL);
+    gtk_css_provider_load_from_path(provider, queue->lookup->stylesheet);
+    queue->specimen = thumbnail_build_specimen();
+    thumbnail_apply_provider(queue->specimen, GTK_STYLE_PROVIDER(provider));
+    g_object_unref(provider);
+
+    // Offset so the host's single visible pixel stays transparent
+    gtk_fixed_put(GTK_FIXED(stage), g_object_ref(queue->specimen), 2, 2);
+    queue->paint_attempts = 0;
+    queue->clock = g_object_ref(clock);
+    queue->paint_handler = g_signal_connect(clock, "after-paint", G_CALLBACK(thumbnail_after_paint), queue);
+    gtk_widget_queue_draw(queue->specimen);
+}
+
+static void thumbnail_lookup_done(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    ThumbnailLookup *lookup = g_task_get_task_data(G_TASK(result));
+    if (!g_task_propagate_boolean(G_TASK(result), NULL))
+    {
+        // Cancelled: the queue and its sidebar are gone
+        thumbnail_lookup_free(lookup);
+        return;
+    }
+
+    ThumbnailQueue *queue = user_data;
+    GtkWidget *picture = g_object_get_data(G_OBJECT(queue->current_row), "thumbnail");
+    if (lookup->texture)
+    {
+        gtk_picture_set_paintable(GTK_PICTURE(picture), GDK_PAINTABLE(lookup->texture));
+    }
+    else if (lookup->stylesheet && queue->resume_id)
+    {
+        // Scrolling started meanwhile; render this row once it settles
+        queue->pending = g_list_prepend(queue->pending, queue->current_row);
+        queue->current_row = NULL;
+    }
+    else if (lookup->stylesheet)
+    {
+        queue->lookup = lookup;
+        thumbnail_render_begin(queue);
+        return;
+    }
+    else
+    {
+        // Nothing to render for themes without GTK CSS
+        gtk_widget_set_visible(picture, FALSE);
+    }
+    thumbnail_lookup_free(lookup);
+    thumbnail_queue_next(queue);
+}
+
+static gboolean thumbnail_row_visible(GtkWidget *row, GtkWidget *viewport)
+{
+    graphene_rect_t bounds;
+    if (!viewport || !gtk_widget_compute_bounds(row, viewport, &bounds))
+        return FALSE;
+    return bounds.origin.y + bounds.size.height > 0 && bounds.origin.y < gtk_widget_get_height(viewport);
+}
+
+// One thumbnail at a time at low priority, rows in view first
+static gboolean thumbnail_queue_step(gpointer user_data)
+{
+    ThumbnailQueue *queue = user_data;
+    queue->idle_id = 0;
+    if (queue->current_row || !queue->pending)
+        return G_SOURCE_REMOVE;
+
+    GtkWidget *viewport = gtk_widget_get_ancestor(queue->listbox, GTK_TYPE_SCROLLED_WINDOW);
+    GList *next = queue->pending;
+    for (GList *l = queue->pending; l != NULL; l = l->next)
+    {
+        if (thumbnail_row_visible(l->data, viewport))
+        {
+            next = l;
+            break;
+        }
+    }
+    queue->current_row = next->data; // takes over the pending list's ref
+    queue->pending = g_list_delete_link(queue->pending, next);
+
+    ThumbnailLookup *lookup = g_new0(ThumbnailLookup, 1);
+    lookup->theme_dir = g_strdup(g_object_get_data(G_OBJECT(queue->current_row), "theme_dir"));
+    GTask *task = g_task_new(NULL, queue->cancellable, thumbnail_lookup_done, queue);
+    g_task_set_task_data(task, lookup, NULL);
+    g_task_run_in_thread(task, thumbnail_lookup_thread);
+    g_object_unref(task);
+    return G_SOURCE_REMOVE;
+}
+
+// Cancel the sidebar's thumbnail work; a lookup still running in a worker
+// sees the cancellation in its callback and never touches the queue
+static void thumbnail_queue_stop(AppWidgets *widgets)
+{
+    ThumbnailQueue *queue = widgets->thumbnails;
+    if (!queue)
+        return;
+    widgets->thumbnails = NULL;
+
+    g_cancellable_cancel(queue->cancellable);
+    g_object_unref(queue->cancellable);
+    if (queue->idle_id)
+        g_source_remove(queue->idle_id);
+    if (queue->resume_id)
+        g_source_remove(queue->resume_id);
+    if (queue->vadjustment)
+    {
+        g_signal_handler_disconnect(queue->vadjustment, queue->scroll_handler);
+        g_object_unref(queue->vadjustment);
+    }
+    thumbnail_discard_specimen(queue);
+    if (queue->lookup)
+        thumbnail_lookup_free(queue->lookup);
+    g_clear_object(&queue->current_row);
+    g_list_free_full(queue->pending, g_object_unref);
+    g_object_unref(queue->listbox);
+    g_free(queue);
+}
+
+// Fill in the sidebar's thumbnails in the background, pausing while it
+// scrolls, and drop cached thumbnails of themes that are no longer
+// installed. The listbox must already be inside its scrolled window.
+static void thumbnail_queue_start(AppWidgets *widgets, GtkWidget *listbox)
+{
+    ThumbnailQueue *queue = g_new0(ThumbnailQueue, 1);
+    queue->widgets = widgets;
+    queue->listbox = g_object_ref(listbox);
+    queue->cancellable = g_cancellable_new();
+    GtkWidget *scrolled = gtk_widget_get_ancestor(listbox, GTK_TYPE_SCROLLED_WINDOW);
+    if (scrolled)
+    {
+        queue->vadjustment = g_object_ref(gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(scrolled)));
+        queue->scroll_handler = g_signal_connect(queue->vadjustment, "value-changed", G_CALLBACK(thumbnail_on_scroll), queue);
+    }
+
+    GHashTable *digests = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    for (GtkWidget *row = gtk_widget_get_first_child(listbox); row != NULL; row = gtk_widget_get_next_sibling(row))
+    {
+        const char *theme_dir = g_object_get_data(G_OBJECT(row), "theme_dir");
+        if (!theme_dir || !g_object_get_data(G_OBJECT(row), "thumbnail"))
+            continue;
+        queue->pending = g_list_prepend(queue->pending, g_object_ref(row));
+        g_hash_table_add(digests, g_compute_checksum_for_string(G_CHECKSUM_MD5, theme_dir, -1));
+    }
+    queue->pending = g_list_reverse(queue->pending);
+    thumbnail_queue_next(queue);
+    widgets->thumbnails = queue;
+
+    GTask *task = g_task_new(NULL, NULL, NULL, NULL);
+    g_task_set_task_data(task, digests, (GDestroyNotify)g_hash_table_unref);
+    g_task_run_in_thread(task, thumbnail_prune_thread);
+    g_object_unref(task);
+}
+
+static GtkWidget *create_thumbnail_picture(void)
+{
+    GtkWidget *picture = gtk_picture_new();
+    gtk_picture_set_can_shrink(GTK_PICTURE(picture), TRUE);
+    // Fixed size so rows do not relayout when the thumbnail arrives
+    gtk_widget_set_size_request(picture, THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT);
+    gtk_widget_set_halign(picture, GTK_ALIGN_CENTER);
+    return picture;
+}
+
+static void palette_scan_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable)
+{
+    GPtrArray *theme_dirs = task_data;
+    ThemePalette palette;
+    for (guint i = 0; i < theme_dirs->len; i++)
+    {
+        if (g_cancellable_is_cancelled(cancellable))
+            break;
+        theme_palette_update(g_ptr_array_index(theme_dirs, i), &palette);
+    }
+    // Only a completed scan has seen every listed theme
+    if (!g_cancellable_is_cancelled(cancellable))
+        palette_cache_prune(theme_dirs);
+    // Keep whatever was scanned, even if the sidebar went away meanwhile
+    palette_cache_save();
+    g_task_return_boolean(task, TRUE);
+}
+
+static void palette_scan_done(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    AppWidgets *widgets = user_data;
+
+    if (!g_task_propagate_boolean(G_TASK(result), NULL))
+        return;
+    if (widgets->palette_scan == g_task_get_cancellable(G_TASK(result)))
+        g_clear_object(&widgets->palette_scan);
+    for (GtkWidget *row = gtk_widget_get_first_child(GTK_WIDGET(source)); row != NULL; row = gtk_widget_get_next_sibling(row))
+    {
+        GtkWidget *swatches = g_object_get_data(G_OBJECT(row), "palette_swatches");
+        if (swatches)
+            gtk_widget_queue_draw(swatches);
+    }
+    GtkWidget *page_swatches = widgets->main_area ? g_object_get_data(G_OBJECT(widgets->main_area), "palette_swatches") : NULL;
+    if (page_swatches)
+        gtk_widget_queue_draw(page_swatches);
+}
+
+// Extract palettes for every listed theme in the background; the sidebar's
+// swatches are redrawn once the scan completes.
+// A rebuilt sidebar supersedes the scan started for the previous one.
+static void palette_scan_sidebar(AppWidgets *widgets, GtkWidget *listbox, GPtrArray *theme_dirs)
+{
+    if (widgets->palette_scan)
+    {
+        g_cancellable_cancel(widgets->palette_scan);
+        g_object_unref(widgets->palette_scan);
+    }
+    widgets->palette_scan = g_cancellable_new();
+
+    GTask *task = g_task_new(listbox, widgets->palette_scan, palette_scan_done, widgets);
+    g_task_set_task_data(task, theme_dirs, (GDestroyNotify)g_ptr_array_unref);
+    g_task_run_in_thread(task, palette_scan_thread);
+    g_object_unref(task);
+}
+
+static void
+on_sidebar_row_selected(GtkListBox *box, GtkListBoxRow *row, gpointer user_data)
+{
+    AppWidgets *widgets = user_data;
+    if (!row || !widgets->main_area)
+        return;
+    ThemeRow *data = g_object_get_data(G_OBJECT(row), "theme_row_data");
+    if (!data)
+        return;
+
+    GtkWidget *new_view = create_theme_metadata_page(data->theme_name, data->location);
+    GtkWidget *parent = gtk_widget_get_parent(widgets->main_area);
+    gtk_box_remove(GTK_BOX(parent), widgets->main_area);
+    widgets->main_area = new_view;
+    gtk_box_append(GTK_BOX(parent), widgets->main_area);
+}
+
+static GtkWidget *
+create_sidebar(AppWidgets *widgets)
+{
+    // The previous sidebar's thumbnails would only race the new ones
+    thumbnail_queue_stop(widgets);
+
+    GtkWidget *listbox = gtk_list_box_new();
+    gtk_list_box_set_selection_mode(GTK_LIST_BOX(listbox), GTK_SELECTION_BROWSE);
+
+    GtkCssProvider *css = gtk_css_provider_new();
+    gtk_css_provider_load_from_string(css, ".row.no-hover:hover { background-color: transparent; }");
+    gtk_style_context_add_provider_for_display(gdk_display_get_default(), GTK_STYLE_PROVIDER(css), GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+    g_object_unref(css);
+
+    GtkWidget *user_label = gtk_label_new("User Themes");
+    gtk_widget_set_margin_top(user_label, 8);
+    gtk_widget_set_margin_bottom(user_label, 2);
+    gtk_widget_set_halign(user_label, GTK_ALIGN_CENTER);
+    gtk_widget_add_css_class(user_label, "heading");
+    // Use GtkBox to hold label so it's not treated as a selectable row
+    GtkWidget *user_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+    gtk_box_append(GTK_BOX(user_box), user_label);
+    GtkWidget *user_row = gtk_list_box_row_new();
+    gtk_list_box_row_set_selectable(GTK_LIST_BOX_ROW(user_row), FALSE);
+    gtk_widget_add_css_class(user_row, "no-hover");
+    gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(user_row), user_box);
+    gtk_list_box_append(GTK_LIST_BOX(listbox), user_row);
+
+    GPtrArray *palette_dirs = g_ptr_array_new_with_free_func(g_free);
+    gchar *theme_manager_path = g_build_filename(g_get_home_dir(), ".themes", NULL);
+    GDir *dir = g_dir_open(theme_manager_path, 0, NULL);
+    GList *user_theme_list = NULL;
+    const gchar *filename;
+    if (dir)
+    {
+        while ((filename = g_dir_read_name(dir)) != NULL)
+        {
+            gchar *theme_dir = g_build_filename(theme_manager_path, filename, NULL);
+            gchar *index_file = g_build_filename(theme_dir, "index.theme", NULL);
+            if (g_file_test(theme_dir, G_FILE_TEST_IS_DIR) && g_file_test(index_file, G_FILE_TEST_EXISTS))
+            {
+                user_theme_list = g_list_prepend(user_theme_list, g_strdup(filename));
+            }
+            g_free(theme_dir);
+            g_free(index_file);
+        }
+        user_theme_list = g_list_sort(user_theme_list, (GCompareFunc)g_ascii_strcasecmp);
+        for (GList *l = user_theme_list; l != NULL; l = l->next)
+        {
+            GtkWidget *row = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+            GtkWidget *thumbnail = create_thumbnail_picture();
+            gtk_widget_set_margin_top(thumbnail, 4);
+            gtk_box_append(GTK_BOX(row), thumbnail);
+            GtkWidget *name_label = gtk_label_new((gchar *)l->data);
+            gtk_widget_set_halign(name_label, GTK_ALIGN_CENTER);
+            GtkWidget *loc_label = gtk_label_new(theme_manager_path);
+            gtk_widget_set_halign(loc_label, GTK_ALIGN_CENTER);
+            gtk_widget_add_css_class(loc_label, "dim-label");
+            gtk_box_append(GTK_BOX(row), name_label);
+            gtk_box_append(GTK_BOX(row), loc_label);
+            gchar *palette_dir = g_build_filename(theme_manager_path, (gchar *)l->data, NULL);
+            GtkWidget *swatches = create_palette_swatches(palette_dir, 10);
+            gtk_widget_set_margin_top(swatches, 4);
+            gtk_box_append(GTK_BOX(row), swatches);
+            g_ptr_array_add(palette_dirs, palette_dir);
+            GtkWidget *list_row = gtk_list_box_row_new();
+            gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(list_row), row);
+            g_object_set_data(G_OBJECT(list_row), "palette_swatches", swatches);
+            g_object_set_data(G_OBJECT(list_row), "thumbnail", thumbnail);
+            g_object_set_data_full(G_OBJECT(list_row), "theme_dir", g_strdup(palette_dir), g_free);
+            ThemeRow *data = g_new0(ThemeRow, 1);
+            data->theme_name = g_strdup((gchar *)l->data);
+            data->location = g_strdup(theme_manager_path);
+            g_object_set_data_full(G_OBJECT(list_row), "theme_row_data", data, (GDestroyNotify)g_free);
+            // Highlight the currently active theme
+            if (g_strcmp0(data->theme_name, "Currently Active Theme Name") == 0)
+            {
+                gtk_widget_add_css_class(list_row, "active-theme");
+            }
+            gtk_list_box_append(GTK_LIST_BOX(listbox), list_row);
+            g_free(l->data);
+        }
+        g_list_free(user_theme_list);
+    }
+    g_free(theme_manager_path);
+    g_dir_close(dir);
+
+    GtkWidget *sep = gtk_separator_new(GTK_ORIENTATION_HORIZONTAL);
+    gtk_list_box_append(GTK_LIST_BOX(listbox), sep);
+    GtkWidget *sep_row = gtk_widget_get_parent(sep);
+    gtk_list_box_row_set_selectable(GTK_LIST_BOX_ROW(sep_row), FALSE);
+
+    GtkWidget *sys_label = gtk_label_new("System Themes");
+    gtk_widget_set_margin_top(sys_label, 8);
+    gtk_widget_set_margin_bottom(sys_label, 2);
+    gtk_widget_set_halign(sys_label, GTK_ALIGN_CENTER);
+    gtk_widget_add_css_class(sys_label, "heading");
+    // Use GtkBox to hold label so it's not treated as a selectable row
+    GtkWidget *sys_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+    gtk_box_append(GTK_BOX(sys_box), sys_label);
+    GtkWidget *sys_row = gtk_list_box_row_new();
+    gtk_list_box_row_set_selectable(GTK_LIST_BOX_ROW(sys_row), FALSE);
+    gtk_widget_add_css_class(sys_row, "no-hover");
+    gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(sys_row), sys_box);
+    gtk_list_box_append(GTK_LIST_BOX(listbox), sys_row);
+
+    dir = g_dir_open("/usr/share/themes", 0, NULL);
+    GList *system_theme_list = NULL;
+    if (dir)
+    {
+        while ((filename = g_dir_read_name(dir)) != NULL)
+        {
+            gchar *theme_dir = g_build_filename("/usr/share/themes", filename, NULL);
+            gchar *index_file = g_build_filename(theme_dir, "index.theme", NULL);
+            if (g_file_test(theme_dir, G_FILE_TEST_IS_DIR) && g_file_test(index_file, G_FILE_TEST_EXISTS))
+            {
+                system_theme_list = g_list_prepend(system_theme_list, g_strdup(filename));
+            }
+            g_free(theme_dir);
+            g_free(index_file);
+        }
+        system_theme_list = g_list_sort(system_theme_list, (GCompareFunc)g_ascii_strcasecmp);
+        for (GList *l = system_theme_list; l != NULL; l = l->next)
+        {
+            GtkWidget *row = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+            GtkWidget *thumbnail = create_thumbnail_picture();
+            gtk_widget_set_margin_top(thumbnail, 4);
+            gtk_box_append(GTK_BOX(row), thumbnail);
+            GtkWidget *name_label = gtk_label_new((gchar *)l->data);
+            gtk_widget_set_halign(name_label, GTK_ALIGN_CENTER);
+            GtkWidget *loc_label = gtk_label_new("/usr/share/themes");
+            gtk_widget_set_halign(loc_label, GTK_ALIGN_CENTER);
+            gtk_widget_add_css_class(loc_label, "dim-label");
+            gtk_box_append(GTK_BOX(row), name_label);
+            gtk_box_append(GTK_BOX(row), loc_label);
+            gchar *palette_dir = g_build_filename("/usr/share/themes", (gchar *)l->data, NULL);
+            GtkWidget *swatches = create_palette_swatches(palette_dir, 10);
+            gtk_widget_set_margin_top(swatches, 4);
+            gtk_box_append(GTK_BOX(row), swatches);
+            g_ptr_array_add(palette_dirs, palette_dir);
+            GtkWidget *list_row = gtk_list_box_row_new();
+            gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(list_row), row);
+            g_object_set_data(G_OBJECT(list_row), "palette_swatches", swatches);
+            g_object_set_data(G_OBJECT(list_row), "thumbnail", thumbnail);
+            g_object_set_data_full(G_OBJECT(list_row), "theme_dir", g_strdup(palette_dir), g_free);
+            ThemeRow *data = g_new0(ThemeRow, 1);
+            data->theme_name = g_strdup((gchar *)l->data);
+            data->location = g_strdup("/usr/share/themes");
+            g_object_set_data_full(G_OBJECT(list_row), "theme_row_data", data, (GDestroyNotify)g_free);
+            // Highlight the currently active theme
+            if (g_strcmp0(data->theme_name, "Currently Active Theme Name") == 0)
+            {
+                gtk_widget_add_css_class(list_row, "active-theme");
+            }
+            gtk_list_box_append(GTK_LIST_BOX(listbox), list_row);
+            g_free(l->data);
+        }
+        g_list_free(system_theme_list);
+    }
+    g_dir_close(dir);
+
+    g_signal_connect(listbox, "row-selected", G_CALLBACK(on_sidebar_row_selected), widgets);
+    palette_scan_sidebar(widgets, listbox, palette_dirs);
+
+    GtkWidget *scrolled = gtk_scrolled_window_new();
+    gtk_widget_set_size_request(scrolled, 200, -1);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), listbox);
+    thumbnail_queue_start(widgets, listbox);
+    g_object_set_data(G_OBJECT(scrolled), "listbox", listbox);
+    widgets->sidebar = scrolled;
+    return scrolled;
+}
+
+// Helper: Extract archive to ~/.themes
+static gboolean extract_theme_archive(const char *filepath)
+{
+    const char *home = g_get_home_dir();
+    gchar *themes_dir = g_build_filename(home, ".themes", NULL);
+    g_mkdir_with_parents(themes_dir, 0755);
+
+    gboolean success = FALSE;
+    if (g_str_has_suffix(filepath, ".zip"))
+    {
+        gchar *cmd = g_strdup_printf("unzip -o '%s' -d '%s'", filepath, themes_dir);
+        int status = system(cmd);
+        success = (status == 0);
+        g_free(cmd);
+    }
+    else if (g_str_has_suffix(filepath, ".tar.gz") || g_str_has_suffix(filepath, ".tgz"))
+    {
+        gchar *cmd = g_strdup_printf("tar -xzf '%s' -C '%s'", filepath, themes_dir);
+        int status = system(cmd);
+        success = (status == 0);
+        g_free(cmd);
+    }
+    else if (g_str_has_suffix(filepath, ".tar.xz"))
+    {
+        gchar *cmd = g_strdup_printf("tar -xJf '%s' -C '%s'", filepath, themes_dir);
+        int status = system(cmd);
+        success = (status == 0);
+        g_free(cmd);
+    }
+    g_free(themes_dir);
+    return success;
+}
+
+// Handler for dropped files
+static GtkWidget *drag_overlay = NULL;
+
+static void show_drag_overlay(GtkWidget *window)
+{
+    if (!drag_overlay)
+    {
+        drag_overlay = gtk_overlay_new();
+        GtkWidget *label = gtk_label_new("Drop archive to install theme");
+        gtk_widget_add_css_class(label, "drag-overlay-label");
+        gtk_widget_set_halign(label, GTK_ALIGN_CENTER);
+        gtk_widget_set_valign(label, GTK_ALIGN_CENTER);
+        gtk_overlay_set_child(GTK_OVERLAY(drag_overlay), label);
+        gtk_widget_set_hexpand(drag_overlay, TRUE);
+        gtk_widget_set_vexpand(drag_overlay, TRUE);
+        gtk_widget_set_opacity(drag_overlay, 0.85);
+    }
+    if (!gtk_widget_get_parent(drag_overlay))
+    {
+        gtk_overlay_add_overlay(GTK_OVERLAY(window), drag_overlay);
+    }
+    gtk_widget_set_visible(drag_overlay, TRUE);
+}
+
+static void hide_drag_overlay(GtkWidget *window)
+{
+    if (drag_overlay && gtk_widget_get_parent(drag_overlay))
+    {
+        gtk_widget_set_visible(drag_overlay, FALSE);
+    }
+}
+
+static void on_main_window_drop(GtkDropTarget *target, const GValue *value, double x, double y, gpointer user_data)
+{
+    AppWidgets *widgets = (AppWidgets *)user_data;
+    GtkWidget *window = gtk_widget_get_ancestor(GTK_WIDGET(gtk_event_controller_get_widget(GTK_EVENT_CONTROLLER(target))), GTK_TYPE_WINDOW);
+    hide_drag_overlay(window);
+    if (G_VALUE_HOLDS(value, G_TYPE_FILE))
+    {
+        GFile *file = g_value_get_object(value);
+        char *path = g_file_get_path(file);
+        if (path)
+        {
+            if (g_str_has_suffix(path, ".zip") || g_str_has_suffix(path, ".tar.gz") || g_str_has_suffix(path, ".tgz") || g_str_has_suffix(path, ".tar.xz"))
+            {
+                if (extract_theme_archive(path))
+                {
+                    show_info_dialog(GTK_WINDOW(window), "Theme installed successfully!");
+                    // Refresh sidebar
+                    GtkWidget *parent = gtk_widget_get_parent(widgets->sidebar);
+                    gtk_box_remove(GTK_BOX(parent), widgets->sidebar);
+                    widgets->sidebar = create_sidebar(widgets);
+                    gtk_box_prepend(GTK_BOX(parent), widgets->sidebar);
+                }
+                else
+                {
+                    show_info_dialog(GTK_WINDOW(window), "Failed to install theme!");
+                }
+            }
+            g_free(path);
+        }
+    }
+}
+
+static gboolean on_main_window_drag_enter(GtkDropTarget *target, double x, double y, gpointer user_data)
+{
+    AppWidgets *widgets = (AppWidgets *)user_data;
+    GtkWidget *window = gtk_widget_get_ancestor(GTK_WIDGET(gtk_event_controller_get_widget(GTK_EVENT_CONTROLLER(target))), GTK_TYPE_WINDOW);
+    show_drag_overlay(window);
+    return TRUE;
+}
+
+static void on_main_window_drag_leave(GtkDropTarget *target, gpointer user_data)
+{
+    AppWidgets *widgets = (AppWidgets *)user_data;
+    GtkWidget *window = gtk_widget_get_ancestor(GTK_WIDGET(gtk_event_controller_get_widget(GTK_EVENT_CONTROLLER(target))), GTK_TYPE_WINDOW);
+    hide_drag_overlay(window);
+}
+
+// --- Theme Repository: catalog from a file:// or http:// mirror ---
+//
+// The mirror serves a GKeyFile catalog named themes.index next to the
+// archives, one group per theme:
+//
+//   [Theme-Name]
+//   Version=1.2
+//   File=Theme-Name-1.2.tar.xz
+//   Size=123456
+//   Sha256=<hex digest of File>
+#define REPO_INDEX_NAME "themes.index"
+#define REPO_CHUNK_SIZE 65536
+#define REPO_TIMEOUT_SECONDS 30
+
+typedef enum
+{
+    REPO_THEME_AVAILABLE,
+    REPO_THEME_INSTALLED,
+    REPO_THEME_OUTDATED
+} RepoThemeStatus;
+
+typedef struct
+{
+    char *name;
+    char *version;
+    char *file;
+    char *sha256;
+    goffset size;
+} RepoTheme;
+
+typedef struct
+{
+    GtkWidget *window;
+    GtkWidget *url_entry;
+    GtkWidget *status_label;
+    GtkWidget *listbox;
+    GPtrArray *themes;
+    GCancellable *cancellable;
+} RepoBrowser;
+
+typedef struct
+{
+    RepoTheme *theme;
+    RepoThemeStatus status;
+    GtkWidget *status_label;
+    GtkWidget *progress;
+    GtkWidget *button;
+} RepoRow;
+
+typedef struct
+{
+    RepoTheme *theme;
+    gchar *url;
+    gchar *part_path;
+    gchar *archive_path;
+    gint received_kb;
+    guint progress_id;
+    GCancellable *cancellable;
+    GtkWidget *status_label;
+    GtkWidget *progress;
+    GtkWidget *button;
+} RepoDownload;
+
+// In-flight downloads by archive path, so two rows never write one .part
+static GHashTable *repo_downloads = NULL;
+
+static void repo_theme_free(RepoTheme *theme)
+{
+    g_free(theme->name);
+    g_free(theme->version);
+    g_free(theme->file);
+    g_free(theme->sha256);
+    g_free(theme);
+}
+
+static RepoTheme *repo_theme_copy(const RepoTheme *theme)
+{
+    RepoTheme *copy = g_new0(RepoTheme, 1);
+    copy->name = g_strdup(theme->name);
+    copy->version = g_strdup(theme->version);
+    copy->file = g_strdup(theme->file);
+    copy->sha256 = g_strdup(theme->sha256);
+    copy->size = theme->size;
+    return copy;
+}
+
+static gchar *repo_config_path(void)
+{
+    return g_build_filename(g_get_user_config_dir(), "theme-manager", "repository.ini", NULL);
+}
+
+static GKeyFile *repo_config_load(void)
+{
+    GKeyFile *config = g_key_file_new();
+    gchar *path = repo_config_path();
+    g_key_file_load_from_file(config, path, G_KEY_FILE_KEEP_COMMENTS, NULL);
+    g_free(path);
+    return config;
+}
+
+static void repo_config_save(GKeyFile *config)
+{
+    gchar *path = repo_config_path();
+    gchar *dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0755);
+    GError *error = NULL;
+    if (!g_key_file_save_to_file(config, path, &error))
+    {
+        g_print("Failed to save repository settings: %s\n", error->message);
+        g_error_free(error);
+    }
+    g_free(dir);
+    g_free(path);
+}
+
+static gchar *repo_get_base_url(void)
+{
+    if (repository_url_option && *repository_url_option)
+        return g_strdup(repository_url_option);
+    GKeyFile *config = repo_config_load();
+    gchar *url = g_key_file_get_string(config, "Repository", "BaseUrl", NULL);
+    g_key_file_unref(config);
+    return url;
+}
+
+static gchar *repo_build_url(const char *base_url, const char *file)
+{
+    gchar *escaped = g_uri_escape_string(file, NULL, FALSE);
+    gchar *url = g_str_has_suffix(base_url, "/") ? g_strconcat(base_url, escaped, NULL)
+                                                 : g_strconcat(base_url, "/", escaped, NULL);
+    g_free(escaped);
+    return url;
+}
+
+// Open url for reading from byte offset. *out_offset receives the offset
+// the returned stream really starts at, since servers may ignore Range.
+static GInputStream *repo_open_stream(const char *url, goffset offset, goffset *out_offset, GCancellable *cancellable, GError **error)
+{
+    *out_offset = 0;
+    if (g_str_has_prefix(url, "file://"))
+    {
+        GFile *file = g_file_new_for_uri(url);
+        GFileInputStream *stream = g_file_read(file, cancellable, error);
+        g_object_unref(file);
+        if (!stream)
+            return NULL;
+        if (offset > 0 && g_seekable_seek(G_SEEKABLE(stream), offset, G_SEEK_SET, cancellable, NULL))
+            *out_offset = offset;
+        return G_INPUT_STREAM(stream);
+    }
+
+    GUri *uri = g_uri_parse(url, G_URI_FLAGS_ENCODED, error);
+    if (!uri)
+        return NULL;
+    if (g_strcmp0(g_uri_get_scheme(uri), "http") != 0 || !g_uri_get_host(uri))
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "Unsupported repository URL: %s", url);
+        g_uri_unref(uri);
+        return NULL;
+    }
+
+    int port = g_uri_get_port(uri);
+    GSocketClient *client = g_socket_client_new();
+    // Also bounds every read, so a stalled mirror fails instead of hanging
+    g_socket_client_set_timeout(client, REPO_TIMEOUT_SECONDS);
+    GSocketConnection *conn = g_socket_client_connect_to_host(client, g_uri_get_host(uri), port > 0 ? port : 80, cancellable, error);
+    g_object_unref(client);
+    if (!conn)
+    {
+        g_uri_unref(uri);
+        return NULL;
+    }
+
+    // HTTP/1.0 keeps the body unchunked and the connection single-use
+    const char *path = *g_uri_get_path(uri) ? g_uri_get_path(uri) : "/";
+    const char *query = g_uri_get_query(uri);
+    // IPv6 literals come back from GUri without their brackets
+    const char *uri_host = g_uri_get_host(uri);
+    gchar *host = strchr(uri_host, ':') ? g_strdup_printf("[%s]", uri_host) : g_strdup(uri_host);
+    if (port > 0 && port != 80)
+    {
+        gchar *with_port = g_strdup_printf("%s:%d", host, port);
+        g_free(host);
+        host = with_port;
+    }
+    GString *request = g_string_new(NULL);
+    g_string_append_printf(request, "GET %s%s%s HTTP/1.0\r\nHost: %s\r\nUser-Agent: theme-manager\r\n",
+                           path, query ? "?" : "", query ? query : "", host);
+    g_free(host);
+    if (offset > 0)
+        g_string_append_printf(request, "Range: bytes=%" G_GOFFSET_FORMAT "-\r\n", offset);
+    g_string_append(request, "\r\n");
+    g_uri_unref(uri);
+
+    GOutputStream *out = g_io_stream_get_output_stream(G_IO_STREAM(conn));
+    gboolean sent = g_output_stream_write_all(out, request->str, request->len, NULL, cancellable, error);
+    g_string_free(request, TRUE);
+    if (!sent)
+    {
+        g_object_unref(conn);
+        return NULL;
+    }
+
+    GDataInputStream *data = g_data_input_stream_new(g_io_stream_get_input_stream(G_IO_STREAM(conn)));
+    g_data_input_stream_set_newline_type(data, G_DATA_STREAM_NEWLINE_TYPE_LF);
+    g_object_set_data_full(G_OBJECT(data), "connection", conn, g_object_unref);
+
+    GError *local_error = NULL;
+    int status = 0;
+    goffset range_start = 0;
+    gchar *line = g_data_input_stream_read_line(data, NULL, cancellable, &local_error);
+    if (line && sscanf(line, "HTTP/%*d.%*d %d", &status) != 1)
+        status = 0;
+    while (line)
+    {
+        g_free(line);
+        line = g_data_input_stream_read_line(data, NULL, cancellable, &local_error);
+        if (!line)
+            break;
+        g_strchomp(line);
+        if (*line == '\0')
+            break;
+        if (g_ascii_strncasecmp(line, "Content-Range:", 14) == 0)
+        {
+            const char *bytes = strstr(line, "bytes");
+            if (bytes)
+                range_start = g_ascii_strtoll(bytes + 5, NULL, 10);
+        }
+    }
+
+    if (!line)
+    {
+        if (local_error)
+            g_propagate_error(error, local_error);
+        else
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT, "Truncated response from %s", url);
+        g_object_unref(data);
+        return NULL;
+    }
+    g_free(line);
+
+    // The partial file is already complete or stale: fetch it again whole
+    if (status == 416 && offset > 0)
+    {
+        g_object_unref(data);
+        return repo_open_stream(url, 0, out_offset, cancellable, error);
+    }
+    if (status != 200 && status != 206)
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "HTTP %d fetching %s", status, url);
+        g_object_unref(data);
+        return NULL;
+    }
+    *out_offset = status == 206 ? range_start : 0;
+    return G_INPUT_STREAM(data);
+}
+
+static GPtrArray *repo_parse_index(const char *data, gsize length, GError **error)
+{
+    GKeyFile *index = g_key_file_new();
+    if (!g_key_file_load_from_data(index, data, length, G_KEY_FILE_NONE, error))
+    {
+        g_key_file_unref(index);
+        return NULL;
+    }
+
+    GPtrArray *themes = g_ptr_array_new_with_free_func((GDestroyNotify)repo_theme_free);
+    gchar **groups = g_key_file_get_groups(index, NULL);
+    for (int i = 0; groups[i] != NULL; i++)
+    {
+        gchar *file = g_key_file_get_string(index, groups[i], "File", NULL);
+        gchar *sha256 = g_key_file_get_string(index, groups[i], "Sha256", NULL);
+        // Archive names end up in a shell command and a cache path, so keep
+        // them to a plain file name
+        if (!file || !sha256 || *file == '.' || file[strspn(file, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789._+-")] != '\0')
+        {
+            g_free(file);
+            g_free(sha256);
+            continue;
+        }
+        RepoTheme *theme = g_new0(RepoTheme, 1);
+        theme->name = g_strdup(groups[i]);
+        theme->version = g_key_file_get_string(index, groups[i], "Version", NULL);
+        theme->file = file;
+        theme->sha256 = sha256;
+        theme->size = g_key_file_get_int64(index, groups[i], "Size", NULL);
+        g_ptr_array_add(themes, theme);
+    }
+    g_strfreev(groups);
+    g_key_file_unref(index);
+    return themes;
+}
+
+static gint repo_theme_compare(gconstpointer a, gconstpointer b)
+{
+    const RepoTheme *ta = *(RepoTheme *const *)a;
+    const RepoTheme *tb = *(RepoTheme *const *)b;
+    return g_ascii_strcasecmp(ta->name, tb->name);
+}
+
+static void repo_fetch_index_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable)
+{
+    const char *base_url = task_data;
+    GError *error = NULL;
+    gchar *url = repo_build_url(base_url, REPO_INDEX_NAME);
+    goffset start;
+    GInputStream *in = repo_open_stream(url, 0, &start, cancellable, &error);
+    g_free(url);
+    if (!in)
+    {
+        g_task_return_error(task, error);
+        return;
+    }
+
+    GOutputStream *mem = g_memory_output_stream_new_resizable();
+    gssize n = g_output_stream_splice(mem, in, G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE | G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET, cancellable, &error);
+    g_object_unref(in);
+    if (n < 0)
+    {
+        g_object_unref(mem);
+        g_task_return_error(task, error);
+        return;
+    }
+
+    GBytes *bytes = g_memory_output_stream_steal_as_bytes(G_MEMORY_OUTPUT_STREAM(mem));
+    g_object_unref(mem);
+    gsize length;
+    const char *data = g_bytes_get_data(bytes, &length);
+    GPtrArray *themes = repo_parse_index(data, length, &error);
+    g_bytes_unref(bytes);
+    if (!themes)
+    {
+        g_task_return_error(task, error);
+        return;
+    }
+    g_ptr_array_sort(themes, repo_theme_compare);
+    g_task_return_pointer(task, themes, (GDestroyNotify)g_ptr_array_unref);
+}
+
+static RepoThemeStatus repo_theme_status(const RepoTheme *theme, GKeyFile *config)
+{
+    gchar *index_file = g_build_filename(g_get_home_dir(), ".themes", theme->name, "index.theme", NULL);
+    gboolean installed = g_file_test(index_file, G_FILE_TEST_EXISTS);
+    g_free(index_file);
+    if (!installed)
+        return REPO_THEME_AVAILABLE;
+
+    // Themes installed by other means have no recorded version
+    gchar *installed_version = g_key_file_get_string(config, "Installed", theme->name, NULL);
+    RepoThemeStatus status = REPO_THEME_INSTALLED;
+    if (installed_version && g_strcmp0(installed_version, theme->version) != 0)
+        status = REPO_THEME_OUTDATED;
+    g_free(installed_version);
+    return status;
+}
+
+static gboolean repo_hash_file_prefix(const char *path, goffset length, GChecksum *checksum, GCancellable *cancellable, GError **error)
+{
+    GFile *file = g_file_new_for_path(path);
+    GFileInputStream *in = g_file_read(file, cancellable, error);
+    g_object_unref(file);
+    if (!in)
+        return FALSE;
+
+    guchar *buffer = g_malloc(REPO_CHUNK_SIZE);
+    goffset remaining = length;
+    gboolean ok = TRUE;
+    while (remaining > 0)
+    {
+        gssize n = g_input_stream_read(G_INPUT_STREAM(in), buffer, MIN(remaining, REPO_CHUNK_SIZE), cancellable, error);
+        if (n <= 0)
+        {
+            if (n == 0)
+                g_set_error(error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT, "Partial download is shorter than expected: %s", path);
+            ok = FALSE;
+            break;
+        }
+        g_checksum_update(checksum, buffer, n);
+        remaining -= n;
+    }
+    g_free(buffer);
+    g_object_unref(in);
+    return ok;
+}
+
+// Fetch the archive into a .part file, resuming from whatever an earlier
+// attempt left behind, hash it on the fly and hand it to the installer.
+static void repo_download_thread(GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable)
+{
+    RepoDownload *dl = task_data;
+    GError *error = NULL;
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    GInputStream *in = NULL;
+    GFileOutputStream *out = NULL;
+    GFile *part = g_file_new_for_path(dl->part_path);
+    guchar *buffer = NULL;
+    gboolean ok = FALSE;
+
+    GStatBuf st;
+    goffset have = g_stat(dl->part_path, &st) == 0 ? st.st_size : 0;
+    if (dl->theme->size > 0 && have > dl->theme->size)
+        have = 0;
+
+    goffset start = 0;
+    if (dl->theme->size > 0 && have == dl->theme->size)
+    {
+        start = have;
+    }
+    else
+    {
+        in = repo_open_stream(dl->url, have, &start, cancellable, &error);
+        if (!in)
+            goto out;
+        if (start != 0 && start != have)
+        {
+            g_set_error(&error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Server resumed %s at the wrong offset", dl->theme->file);
+            goto out;
+        }
+    }
 
-    dir = g_dir_open("/usr/share/themes", 0, NULL);
-    GList *system_theme_list = NULL;
-    if (dir)
+    if (start > 0 && !repo_hash_file_prefix(dl->part_path, start, checksum, cancellable, &error))
+        goto out;
+    g_atomic_int_set(&dl->received_kb, (gint)(start / 1024));
+
+    if (in)
     {
-        while ((filename = g_dir_read_name(dir)) != NULL)
+        if (start > 0)
+            out = g_file_append_to(part, G_FILE_CREATE_NONE, cancellable, &error);
+        else
+            out = g_file_replace(part, NULL, FALSE, G_FILE_CREATE_NONE, cancellable, &error);
+        if (!out)
+            goto out;
+
+        buffer = g_malloc(REPO_CHUNK_SIZE);
+        goffset received = start;
+        gssize n;
+        while ((n = g_input_stream_read(in, buffer, REPO_CHUNK_SIZE, cancellable, &error)) > 0)
         {
-            gchar *theme_dir = g_build_filename("/usr/share/themes", filename, NULL);
-            gchar *index_file = g_build_filename(theme_dir, "index.theme", NULL);
-            if (g_file_test(theme_dir, G_FILE_TEST_IS_DIR) && g_file_test(index_file, G_FILE_TEST_EXISTS))
-            {
-                system_theme_list = g_list_prepend(system_theme_list, g_strdup(filename));
-            }
-            g_free(theme_dir);
-            g_free(index_file);
+            g_checksum_update(checksum, buffer, n);
+            if (!g_output_stream_write_all(G_OUTPUT_STREAM(out), buffer, n, NULL, cancellable, &error))
+                break;
+            received += n;
+            g_atomic_int_set(&dl->received_kb, (gint)(received / 1024));
         }
-        system_theme_list = g_list_sort(system_theme_list, (GCompareFunc)g_ascii_strcasecmp);
-        for (GList *l = system_theme_list; l != NULL; l = l->next)
+        // Keep the partial file on failure so the next attempt can resume
+        if (!g_output_stream_close(G_OUTPUT_STREAM(out), cancellable, error ? NULL : &error) || error)
+            goto out;
+        if (dl->theme->size > 0 && received < dl->theme->size)
         {
-            GtkWidget *row = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
-            GtkWidget *name_label = gtk_label_new((gchar *)l->data);
-            gtk_widget_set_halign(name_label, GTK_ALIGN_CENTER);
-            GtkWidget *loc_label = gtk_label_new("/usr/share/themes");
-            gtk_widget_set_halign(loc_label, GTK_ALIGN_CENTER);
-            gtk_widget_add_css_class(loc_label, "dim-label");
-            gtk_box_append(GTK_BOX(row), name_label);
-            gtk_box_append(GTK_BOX(row), loc_label);
-            GtkWidget *list_row = gtk_list_box_row_new();
-            gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(list_row), row);
-            ThemeRow *data = g_new0(ThemeRow, 1);
-            data->theme_name = g_strdup((gchar *)l->data);
-            data->location = g_strdup("/usr/share/themes");
-            g_object_set_data_full(G_OBJECT(list_row), "theme_row_data", data, (GDestroyNotify)g_free);
-            // Highlight the currently active theme
-            if (g_strcmp0(data->theme_name, "Currently Active Theme Name") == 0)
-            {
-                gtk_widget_add_css_class(list_row, "active-theme");
-            }
-            gtk_list_box_append(GTK_LIST_BOX(listbox), list_row);
-            g_free(l->data);
+            g_set_error(&error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT, "Connection closed early, retry to resume %s", dl->theme->file);
+            goto out;
         }
-        g_list_free(system_theme_list);
     }
-    g_dir_close(dir);
 
-    g_signal_connect(listbox, "row-selected", G_CALLBACK(on_sidebar_row_selected), widgets);
+    if (g_ascii_strcasecmp(g_checksum_get_string(checksum), dl->theme->sha256) != 0)
+    {
+        g_remove(dl->part_path);
+        g_set_error(&error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Checksum mismatch for %s", dl->theme->file);
+        goto out;
+    }
 
-    GtkWidget *scrolled = gtk_scrolled_window_new();
-    gtk_widget_set_size_request(scrolled, 200, -1);
-    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), listbox);
-    g_object_set_data(G_OBJECT(scrolled), "listbox", listbox);
-    widgets->sidebar = scrolled;
-    return scrolled;
+    if (g_rename(dl->part_path, dl->archive_path) != 0)
+    {
+        g_set_error(&error, G_FILE_ERROR, G_FILE_ERROR_FAILED, "Failed to move download into place: %s", dl->archive_path);
+        goto out;
+    }
+    ok = extract_theme_archive(dl->archive_path);
+    g_remove(dl->archive_path);
+    if (!ok)
+        g_set_error(&error, G_IO_ERROR, G_IO_ERROR_FAILED, "Failed to install %s", dl->theme->file);
+
+out:
+    g_free(buffer);
+    g_clear_object(&out);
+    g_clear_object(&in);
+    g_object_unref(part);
+    g_checksum_free(checksum);
+    if (ok)
+        g_task_return_boolean(task, TRUE);
+    else
+        g_task_return_error(task, error);
 }
 
-// Helper: Extract archive to ~/.themes
-static gboolean extract_theme_archive(const char *filepath)
+static void repo_download_free(gpointer data)
 {
-    const char *home = g_get_home_dir();
-    gchar *themes_dir = g_build_filename(home, ".themes", NULL);
-    g_mkdir_with_parents(themes_dir, 0755);
+    RepoDownload *dl = data;
+    if (dl->progress_id)
+        g_source_remove(dl->progress_id);
+    repo_theme_free(dl->theme);
+    g_free(dl->url);
+    g_free(dl->part_path);
+    g_free(dl->archive_path);
+    g_object_unref(dl->cancellable);
+    g_object_unref(dl->status_label);
+    g_object_unref(dl->progress);
+    g_object_unref(dl->button);
+    g_free(dl);
+}
 
-    gboolean success = FALSE;
-    if (g_str_has_suffix(filepath, ".zip"))
+static gboolean repo_download_progress(gpointer user_data)
+{
+    RepoDownload *dl = user_data;
+    if (dl->theme->size > 0)
     {
-        gchar *cmd = g_strdup_printf("unzip -o '%s' -d '%s'", filepath, themes_dir);
-        int status = system(cmd);
-        success = (status == 0);
-        g_free(cmd);
+        double fraction = g_atomic_int_get(&dl->received_kb) * 1024.0 / dl->theme->size;
+        gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(dl->progress), MIN(fraction, 1.0));
     }
-    else if (g_str_has_suffix(filepath, ".tar.gz") || g_str_has_suffix(filepath, ".tgz"))
+    else
     {
-        gchar *cmd = g_strdup_printf("tar -xzf '%s' -C '%s'", filepath, themes_dir);
-        int status = system(cmd);
-        success = (status == 0);
-        g_free(cmd);
+        gtk_progress_bar_pulse(GTK_PROGRESS_BAR(dl->progress));
     }
-    else if (g_str_has_suffix(filepath, ".tar.xz"))
+    return G_SOURCE_CONTINUE;
+}
+
+static void repo_download_done(GObject *source, GAsyncResult *result, gpointer user_data)
+{
+    RepoDownload *dl = g_task_get_task_data(G_TASK(result));
+    GError *error = NULL;
+
+    g_hash_table_remove(repo_downloads, dl->archive_path);
+    g_source_remove(dl->progress_id);
+    dl->progress_id = 0;
+    gtk_widget_set_visible(dl->progress, FALSE);
+
+    if (g_task_propagate_boolean(G_TASK(result), &error))
     {
-        gchar *cmd = g_strdup_printf("tar -xJf '%s' -C '%s'", filepath, themes_dir);
-        int status = system(cmd);
-        success = (status == 0);
-        g_free(cmd);
+        GKeyFile *config = repo_config_load();
+        g_key_file_set_string(config, "Installed", dl->theme->name, dl->theme->version ? dl->theme->version : "");
+        repo_config_save(config);
+        g_key_file_unref(config);
+        g_object_set_data(G_OBJECT(dl->button), "repo_installed", GINT_TO_POINTER(TRUE));
+        gtk_label_set_text(GTK_LABEL(dl->status_label), "Installed");
+        gtk_button_set_label(GTK_BUTTON(dl->button), "Reinstall");
+    }
+    else if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+        gtk_label_set_text(GTK_LABEL(dl->status_label), "Cancelled");
+        gtk_button_set_label(GTK_BUTTON(dl->button), "Resume");
+        g_error_free(error);
+    }
+    else
+    {
+        gtk_label_set_text(GTK_LABEL(dl->status_label), error->message);
+        gtk_button_set_label(GTK_BUTTON(dl->button), "Retry");
+        g_error_free(error);
     }
-    g_free(themes_dir);
-    return success;
 }
 
-// Handler for dropped files
-static GtkWidget *drag_overlay = NULL;
+static gchar *repo_archive_path(const RepoTheme *theme)
+{
+    return g_build_filename(g_get_user_cache_dir(), "theme-manager", "downloads", theme->file, NULL);
+}
 
-static void show_drag_overlay(GtkWidget *window)
+static RepoDownload *repo_find_download(const RepoTheme *theme)
 {
-    if (!drag_overlay)
+    if (!repo_downloads)
+        return NULL;
+    gchar *archive_path = repo_archive_path(theme);
+    RepoDownload *dl = g_hash_table_lookup(repo_downloads, archive_path);
+    g_free(archive_path);
+    return dl;
+}
+
+// Show a running download in row, which may belong to a newer listing or
+// another repository window than the one that started it
+static void repo_download_bind(RepoDownload *dl, RepoRow *row)
+{
+    if (dl->button != row->button)
     {
-        drag_overlay = gtk_overlay_new();
-        GtkWidget *label = gtk_label_new("Drop archive to install theme");
-        gtk_widget_add_css_class(label, "drag-overlay-label");
-        gtk_widget_set_halign(label, GTK_ALIGN_CENTER);
-        gtk_widget_set_valign(label, GTK_ALIGN_CENTER);
-        gtk_overlay_set_child(GTK_OVERLAY(drag_overlay), label);
-        gtk_widget_set_hexpand(drag_overlay, TRUE);
-        gtk_widget_set_vexpand(drag_overlay, TRUE);
-        gtk_widget_set_opacity(drag_overlay, 0.85);
+        g_set_object(&dl->status_label, row->status_label);
+        g_set_object(&dl->progress, row->progress);
+        g_set_object(&dl->button, row->button);
     }
-    if (!gtk_widget_get_parent(drag_overlay))
+    gtk_label_set_text(GTK_LABEL(row->status_label), "Downloading...");
+    gtk_button_set_label(GTK_BUTTON(row->button), "Cancel");
+    gtk_widget_set_visible(row->progress, TRUE);
+    repo_download_progress(dl);
+}
+
+static void repo_start_download(RepoRow *row)
+{
+    if (repo_find_download(row->theme))
+        return;
+
+    gchar *base_url = repo_get_base_url();
+    if (!base_url)
+        return;
+
+    RepoDownload *dl = g_new0(RepoDownload, 1);
+    dl->theme = repo_theme_copy(row->theme);
+    dl->url = repo_build_url(base_url, row->theme->file);
+    dl->archive_path = repo_archive_path(row->theme);
+    dl->part_path = g_strconcat(dl->archive_path, ".part", NULL);
+    dl->cancellable = g_cancellable_new();
+    dl->status_label = g_object_ref(row->status_label);
+    dl->progress = g_object_ref(row->progress);
+    dl->button = g_object_ref(row->button);
+    g_free(base_url);
+
+    gchar *download_dir = g_path_get_dirname(dl->archive_path);
+    g_mkdir_with_parents(download_dir, 0755);
+    g_free(download_dir);
+
+    if (!repo_downloads)
+        repo_downloads = g_hash_table_new(g_str_hash, g_str_equal);
+    g_hash_table_insert(repo_downloads, dl->archive_path, dl);
+
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(row->progress), 0.0);
+    repo_download_bind(dl, row);
+    dl->progress_id = g_timeout_add(100, repo_download_progress, dl);
+
+    // Each download runs on its own worker, so several proceed in parallel.
+    // A finished install is reported as such even if Cancel came too late.
+    GTask *task = g_task_new(NULL, dl->cancellable, repo_download_done, NULL);
+    g_task_set_check_cancellable(task, FALSE);
+    g_task_set_task_data(task, dl, repo_download_free);
+    g_task_run_in_thread(task, repo_download_thread);
+    g_object_unref(task);
+}
+
+static void on_repo_row_button_clicked(GtkButton *button, gpointer user_data)
+{
+    RepoRow *row = user_data;
+    RepoDownload *dl = repo_find_download(row->theme);
+    if (dl)
+        g_cancellable_cancel(dl->cancellable);
+    else
+        repo_start_download(row);
+}
+
+static const char *repo_status_text(RepoThemeStatus status)
+{
+    switch (status)
     {
-        gtk_overlay_add_overlay(GTK_OVERLAY(window), drag_overlay);
+    case REPO_THEME_INSTALLED:
+        return "Installed";
+    case REPO_THEME_OUTDATED:
+        return "Update available";
+    default:
+        return "Available";
     }
-    gtk_widget_set_visible(drag_overlay, TRUE);
 }
 
-static void hide_drag_overlay(GtkWidget *window)
+static void repo_browser_populate(RepoBrowser *browser)
 {
-    if (drag_overlay && gtk_widget_get_parent(drag_overlay))
+    GtkWidget *child;
+    while ((child = gtk_widget_get_first_child(browser->listbox)) != NULL)
+        gtk_list_box_remove(GTK_LIST_BOX(browser->listbox), child);
+
+    GKeyFile *config = repo_config_load();
+    for (guint i = 0; i < browser->themes->len; i++)
     {
-        gtk_widget_set_visible(drag_overlay, FALSE);
+        RepoTheme *theme = g_ptr_array_index(browser->themes, i);
+        RepoRow *row = g_new0(RepoRow, 1);
+        row->theme = theme;
+        row->status = repo_theme_status(theme, config);
+
+        GtkWidget *hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+        gtk_widget_set_margin_top(hbox, 6);
+        gtk_widget_set_margin_bottom(hbox, 6);
+        gtk_widget_set_margin_start(hbox, 8);
+        gtk_widget_set_margin_end(hbox, 8);
+
+        GtkWidget *text_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+        gtk_widget_set_hexpand(text_box, TRUE);
+        GtkWidget *name_label = gtk_label_new(theme->name);
+        gtk_label_set_xalign(GTK_LABEL(name_label), 0.0f);
+        gchar *size = g_format_size(theme->size);
+        gchar *details = g_strdup_printf("%s · %s", theme->version ? theme->version : "unversioned", size);
+        GtkWidget *details_label = gtk_label_new(details);
+        gtk_label_set_xalign(GTK_LABEL(details_label), 0.0f);
+        gtk_widget_add_css_class(details_label, "dim-label");
+        g_free(details);
+        g_free(size);
+        gtk_box_append(GTK_BOX(text_box), name_label);
+        gtk_box_append(GTK_BOX(text_box), details_label);
+
+        row->status_label = gtk_label_new(repo_status_text(row->status));
+        gtk_widget_add_css_class(row->status_label, "dim-label");
+
+        row->progress = gtk_progress_bar_new();
+        gtk_widget_set_valign(row->progress, GTK_ALIGN_CENTER);
+        gtk_widget_set_size_request(row->progress, 80, -1);
+        gtk_widget_set_visible(row->progress, FALSE);
+
+        row->button = gtk_button_new_with_label(row->status == REPO_THEME_OUTDATED    ? "Update"
+                                                : row->status == REPO_THEME_INSTALLED ? "Reinstall"
+                                                                                      : "Install");
+        if (row->status == REPO_THEME_OUTDATED)
+            gtk_widget_add_css_class(row->button, "suggested-action");
+        g_signal_connect(row->button, "clicked", G_CALLBACK(on_repo_row_button_clicked), row);
+        RepoDownload *running = repo_find_download(theme);
+        if (running)
+            repo_download_bind(running, row);
+
+        gtk_box_append(GTK_BOX(hbox), text_box);
+        gtk_box_append(GTK_BOX(hbox), row->status_label);
+        gtk_box_append(GTK_BOX(hbox), row->progress);
+        gtk_box_append(GTK_BOX(hbox), row->button);
+
+        GtkWidget *list_row = gtk_list_box_row_new();
+        gtk_list_box_row_set_child(GTK_LIST_BOX_ROW(list_row), hbox);
+        g_object_set_data_full(G_OBJECT(list_row), "repo_row", row, g_free);
+        gtk_list_box_append(GTK_LIST_BOX(browser->listbox), list_row);
     }
+    g_key_file_unref(config);
+
+    gchar *summary = g_strdup_printf("%u themes in repository", browser->themes->len);
+    gtk_label_set_text(GTK_LABEL(browser->status_label), summary);
+    g_free(summary);
 }
 
-static void on_main_window_drop(GtkDropTarget *target, const GValue *value, double x, double y, gpointer user_data)
+static void repo_fetch_index_done(GObject *source, GAsyncResult *result, gpointer user_data)
 {
-    AppWidgets *widgets = (AppWidgets *)user_data;
-    GtkWidget *window = gtk_widget_get_ancestor(GTK_WIDGET(gtk_event_controller_get_widget(GTK_EVENT_CONTROLLER(target))), GTK_TYPE_WINDOW);
-    hide_drag_overlay(window);
-    if (G_VALUE_HOLDS(value, G_TYPE_FILE))
+    GError *error = NULL;
+    GPtrArray *themes = g_task_propagate_pointer(G_TASK(result), &error);
+    if (!themes)
     {
-        GFile *file = g_value_get_object(value);
-        char *path = g_file_get_path(file);
-        if (path)
+        // A cancelled fetch means the browser window is already gone
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
         {
-            if (g_str_has_suffix(path, ".zip") || g_str_has_suffix(path, ".tar.gz") || g_str_has_suffix(path, ".tgz") || g_str_has_suffix(path, ".tar.xz"))
-            {
-                if (extract_theme_archive(path))
-                {
-                    show_info_dialog(GTK_WINDOW(window), "Theme installed successfully!");
-                    // Refresh sidebar
-                    GtkWidget *parent = gtk_widget_get_parent(widgets->sidebar);
-                    gtk_box_remove(GTK_BOX(parent), widgets->sidebar);
-                    widgets->sidebar = create_sidebar(widgets);
-                    gtk_box_prepend(GTK_BOX(parent), widgets->sidebar);
-                }
-                else
-                {
-                    show_info_dialog(GTK_WINDOW(window), "Failed to install theme!");
-                }
-            }
-            g_free(path);
+            RepoBrowser *browser = user_data;
+            gtk_label_set_text(GTK_LABEL(browser->status_label), error->message);
         }
+        g_error_free(error);
+        return;
     }
+
+    RepoBrowser *browser = user_data;
+    if (browser->themes)
+        g_ptr_array_unref(browser->themes);
+    browser->themes = themes;
+    repo_browser_populate(browser);
 }
 
-static gboolean on_main_window_drag_enter(GtkDropTarget *target, double x, double y, gpointer user_data)
+static void repo_browser_load(RepoBrowser *browser)
 {
-    AppWidgets *widgets = (AppWidgets *)user_data;
-    GtkWidget *window = gtk_widget_get_ancestor(GTK_WIDGET(gtk_event_controller_get_widget(GTK_EVENT_CONTROLLER(target))), GTK_TYPE_WINDOW);
-    show_drag_overlay(window);
-    return TRUE;
+    gchar *base_url = repo_get_base_url();
+    if (!base_url || !*base_url)
+    {
+        gtk_label_set_text(GTK_LABEL(browser->status_label), "Enter a file:// or http:// repository URL");
+        g_free(base_url);
+        return;
+    }
+
+    if (browser->cancellable)
+    {
+        g_cancellable_cancel(browser->cancellable);
+        g_object_unref(browser->cancellable);
+    }
+    browser->cancellable = g_cancellable_new();
+    gtk_label_set_text(GTK_LABEL(browser->status_label), "Loading repository index...");
+
+    GTask *task = g_task_new(NULL, browser->cancellable, repo_fetch_index_done, browser);
+    g_task_set_task_data(task, base_url, g_free);
+    g_task_run_in_thread(task, repo_fetch_index_thread);
+    g_object_unref(task);
 }
 
-static void on_main_window_drag_leave(GtkDropTarget *target, gpointer user_data)
+static void on_repo_load_clicked(GtkButton *button, gpointer user_data)
 {
-    AppWidgets *widgets = (AppWidgets *)user_data;
-    GtkWidget *window = gtk_widget_get_ancestor(GTK_WIDGET(gtk_event_controller_get_widget(GTK_EVENT_CONTROLLER(target))), GTK_TYPE_WINDOW);
-    hide_drag_overlay(window);
+    RepoBrowser *browser = user_data;
+    const char *url = gtk_editable_get_text(GTK_EDITABLE(browser->url_entry));
+
+    GKeyFile *config = repo_config_load();
+    g_key_file_set_string(config, "Repository", "BaseUrl", url);
+    repo_config_save(config);
+    g_key_file_unref(config);
+
+    // An explicit choice in the UI wins over --repository
+    g_free(repository_url_option);
+    repository_url_option = NULL;
+    repo_browser_load(browser);
+}
+
+static void on_repo_update_all_clicked(GtkButton *button, gpointer user_data)
+{
+    RepoBrowser *browser = user_data;
+    for (GtkWidget *child = gtk_widget_get_first_child(browser->listbox); child != NULL; child = gtk_widget_get_next_sibling(child))
+    {
+        RepoRow *row = g_object_get_data(G_OBJECT(child), "repo_row");
+        if (row && row->status == REPO_THEME_OUTDATED && !g_object_get_data(G_OBJECT(row->button), "repo_installed"))
+            repo_start_download(row);
+    }
+}
+
+static void repo_browser_free(gpointer data)
+{
+    RepoBrowser *browser = data;
+    if (browser->cancellable)
+    {
+        g_cancellable_cancel(browser->cancellable);
+        g_object_unref(browser->cancellable);
+    }
+    if (browser->themes)
+        g_ptr_array_unref(browser->themes);
+    g_free(browser);
+}
+
+static void on_repository_button_clicked(GtkButton *button, gpointer user_data)
+{
+    GtkWindow *parent = GTK_WINDOW(gtk_widget_get_ancestor(GTK_WIDGET(button), GTK_TYPE_WINDOW));
+    RepoBrowser *browser = g_new0(RepoBrowser, 1);
+
+    browser->window = gtk_window_new();
+    gtk_window_set_title(GTK_WINDOW(browser->window), "Theme Repository");
+    gtk_window_set_transient_for(GTK_WINDOW(browser->window), parent);
+    gtk_window_set_default_size(GTK_WINDOW(browser->window), 560, 480);
+    g_object_set_data_full(G_OBJECT(browser->window), "repo_browser", browser, repo_browser_free);
+
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 8);
+    gtk_widget_set_margin_top(box, 12);
+    gtk_widget_set_margin_bottom(box, 12);
+    gtk_widget_set_margin_start(box, 12);
+    gtk_widget_set_margin_end(box, 12);
+    gtk_window_set_child(GTK_WINDOW(browser->window), box);
+
+    GtkWidget *url_bar = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+    browser->url_entry = gtk_entry_new();
+    gtk_widget_set_hexpand(browser->url_entry, TRUE);
+    gtk_entry_set_placeholder_text(GTK_ENTRY(browser->url_entry), "http://mirror.example/themes/");
+    gchar *base_url = repo_get_base_url();
+    if (base_url)
+        gtk_editable_set_text(GTK_EDITABLE(browser->url_entry), base_url);
+    g_free(base_url);
+    GtkWidget *load_button = gtk_button_new_with_label("Load");
+    g_signal_connect(load_button, "clicked", G_CALLBACK(on_repo_load_clicked), browser);
+    g_signal_connect_swapped(browser->url_entry, "activate", G_CALLBACK(gtk_widget_activate), load_button);
+    GtkWidget *update_all_button = gtk_button_new_with_label("Update All");
+    gtk_widget_add_css_class(update_all_button, "suggested-action");
+    g_signal_connect(update_all_button, "clicked", G_CALLBACK(on_repo_update_all_clicked), browser);
+    gtk_box_append(GTK_BOX(url_bar), browser->url_entry);
+    gtk_box_append(GTK_BOX(url_bar), load_button);
+    gtk_box_append(GTK_BOX(url_bar), update_all_button);
+    gtk_box_append(GTK_BOX(box), url_bar);
+
+    browser->status_label = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(browser->status_label), 0.0f);
+    gtk_label_set_wrap(GTK_LABEL(browser->status_label), TRUE);
+    gtk_widget_add_css_class(browser->status_label, "dim-label");
+    gtk_box_append(GTK_BOX(box), browser->status_label);
+
+    browser->listbox = gtk_list_box_new();
+    gtk_list_box_set_selection_mode(GTK_LIST_BOX(browser->listbox), GTK_SELECTION_NONE);
+    GtkWidget *scrolled = gtk_scrolled_window_new();
+    gtk_widget_set_vexpand(scrolled, TRUE);
+    gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scrolled), browser->listbox);
+    gtk_box_append(GTK_BOX(box), scrolled);
+
+    repo_browser_load(browser);
+    gtk_window_present(GTK_WINDOW(browser->window));
 }
 
 static void
@@ -535,11 +2525,127 @@ on_themes_dir_changed(GFileMonitor *monitor, GFile *file, GFile *other_file, GFi
     }
 }
 
+static gboolean
+on_startup_idle(gpointer user_data)
+{
+    GtkWidget *window = GTK_WIDGET(user_data);
+    StartupCtx *ctx = g_object_get_data(G_OBJECT(window), "startup_ctx");
+    AppWidgets *widgets = ctx->widgets;
+
+    switch (ctx->stage)
+    {
+    case STARTUP_STAGE_CSS:
+        load_custom_css();
+        break;
+    case STARTUP_STAGE_MONITOR:
+    {
+        // Setup GFileMonitor for ~/.themes
+        gchar *themes_dir = g_build_filename(g_get_home_dir(), ".themes", NULL);
+        GFile *themes_gfile = g_file_new_for_path(themes_dir);
+        widgets->themes_monitor = g_file_monitor_directory(themes_gfile, G_FILE_MONITOR_NONE, NULL, NULL);
+        if (widgets->themes_monitor)
+            g_signal_connect(widgets->themes_monitor, "changed", G_CALLBACK(on_themes_dir_changed), widgets);
+        g_object_unref(themes_gfile);
+        g_free(themes_dir);
+        break;
+    }
+    case STARTUP_STAGE_SIDEBAR:
+        // Swap the placeholder for the real theme list
+        gtk_box_remove(GTK_BOX(ctx->main_box), widgets->sidebar);
+        widgets->sidebar = create_sidebar(widgets);
+        gtk_box_prepend(GTK_BOX(ctx->main_box), widgets->sidebar);
+        ctx->sidebar_ready = TRUE;
+        break;
+    case STARTUP_STAGE_DETAIL:
+    {
+        // A row picked in the meantime has already replaced the startup area
+        if (widgets->main_area != ctx->startup_area)
+            break;
+        GtkWidget *child;
+        while ((child = gtk_widget_get_first_child(widgets->main_area)) != NULL)
+            gtk_box_remove(GTK_BOX(widgets->main_area), child);
+        GtkWidget *empty_label = gtk_label_new("Select a theme to view details");
+        gtk_box_append(GTK_BOX(widgets->main_area), empty_label);
+        break;
+    }
+    case STARTUP_STAGE_DONE:
+        break;
+    }
+
+    ctx->stage++;
+    if (ctx->stage < STARTUP_STAGE_DONE)
+        return G_SOURCE_CONTINUE;
+    ctx->idle_id = 0;
+    return G_SOURCE_REMOVE;
+}
+
 static void
-activate(GtkApplication *app, gpointer user_data)
+on_startup_after_paint(GdkFrameClock *clock, gpointer user_data)
+{
+    GtkWidget *window = GTK_WIDGET(user_data);
+    StartupCtx *ctx = g_object_get_data(G_OBJECT(window), "startup_ctx");
+    if (!ctx)
+        return;
+
+    if (!ctx->first_frame_seen)
+    {
+        ctx->first_frame_seen = TRUE;
+        if (measure_startup)
+            g_print("first-frame-ms: %.2f\n", (g_get_monotonic_time() - startup_begin_time) / 1000.0);
+        // Only start the heavy work once the placeholder is on screen
+        ctx->idle_id = g_idle_add(on_startup_idle, window);
+        return;
+    }
+
+    if (ctx->sidebar_ready)
+    {
+        if (measure_startup)
+        {
+            g_print("interactive-sidebar-ms: %.2f\n", (g_get_monotonic_time() - startup_begin_time) / 1000.0);
+            g_application_quit(G_APPLICATION(gtk_window_get_application(GTK_WINDOW(window))));
+        }
+        g_signal_handlers_disconnect_by_func(clock, on_startup_after_paint, window);
+    }
+}
+
+static void
+on_window_map(GtkWidget *window, gpointer user_data)
+{
+    GdkFrameClock *clock = gtk_widget_get_frame_clock(window);
+    if (clock)
+        g_signal_connect_object(clock, "after-paint", G_CALLBACK(on_startup_after_paint), window, 0);
+    g_signal_handlers_disconnect_by_func(window, on_window_map, user_data);
+}
+
+static void
+startup_ctx_free(gpointer data)
 {
-    load_custom_css();
+    StartupCtx *ctx = data;
+    if (ctx->idle_id)
+        g_source_remove(ctx->idle_id);
+    g_free(ctx);
+}
+
+static GtkWidget *
+create_sidebar_placeholder(void)
+{
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 8);
+    gtk_widget_set_size_request(box, 200, -1);
+    gtk_widget_set_valign(box, GTK_ALIGN_CENTER);
+
+    GtkWidget *spinner = gtk_spinner_new();
+    gtk_spinner_start(GTK_SPINNER(spinner));
+    gtk_box_append(GTK_BOX(box), spinner);
+
+    GtkWidget *label = gtk_label_new("Loading themes...");
+    gtk_widget_add_css_class(label, "dim-label");
+    gtk_box_append(GTK_BOX(box), label);
+    return box;
+}
 
+static void
+activate(GtkApplication *app, gpointer user_data)
+{
     AppWidgets *widgets = g_new0(AppWidgets, 1);
 
     GtkWidget *window = gtk_application_window_new(app);
@@ -549,6 +2655,12 @@ activate(GtkApplication *app, gpointer user_data)
 
     gtk_window_set_icon_name(GTK_WINDOW(window), "your-icon-name");
 
+    GtkWidget *header = gtk_header_bar_new();
+    GtkWidget *repository_button = gtk_button_new_with_label("Repository");
+    g_signal_connect(repository_button, "clicked", G_CALLBACK(on_repository_button_clicked), NULL);
+    gtk_header_bar_pack_start(GTK_HEADER_BAR(header), repository_button);
+    gtk_window_set_titlebar(GTK_WINDOW(window), header);
+
     // Enable drag-and-drop for archive files
     GtkDropTarget *drop_target = gtk_drop_target_new(G_TYPE_FILE, GDK_ACTION_COPY);
     g_signal_connect(drop_target, "drop", G_CALLBACK(on_main_window_drop), widgets);
@@ -556,20 +2668,12 @@ activate(GtkApplication *app, gpointer user_data)
     g_signal_connect(drop_target, "leave", G_CALLBACK(on_main_window_drag_leave), widgets);
     gtk_widget_add_controller(window, GTK_EVENT_CONTROLLER(drop_target));
 
-    // Setup GFileMonitor for ~/.themes
-    const char *home = g_get_home_dir();
-    gchar *themes_dir = g_build_filename(home, ".themes", NULL);
-    GFile *themes_gfile = g_file_new_for_path(themes_dir);
-    GFileMonitor *themes_monitor = g_file_monitor_directory(themes_gfile, G_FILE_MONITOR_NONE, NULL, NULL);
-    g_signal_connect(themes_monitor, "changed", G_CALLBACK(on_themes_dir_changed), widgets);
-    g_object_unref(themes_gfile);
-    g_free(themes_dir);
-
     GtkWidget *main_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
     gtk_window_set_child(GTK_WINDOW(window), main_box);
 
-    GtkWidget *sidebar = create_sidebar(widgets);
-    gtk_box_append(GTK_BOX(main_box), sidebar);
+    // Placeholder until the theme list is discovered on idle
+    widgets->sidebar = create_sidebar_placeholder();
+    gtk_box_append(GTK_BOX(main_box), widgets->sidebar);
 
     // Create a vertical box to hold the main view
     GtkWidget *main_view_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
@@ -580,16 +2684,34 @@ activate(GtkApplication *app, gpointer user_data)
     gtk_widget_set_vexpand(widgets->main_area, TRUE);
     gtk_box_append(GTK_BOX(main_view_box), widgets->main_area);
 
-    // Ensure the main view starts empty
-    GtkWidget *empty_label = gtk_label_new("Select a theme to view details");
-    gtk_box_append(GTK_BOX(widgets->main_area), empty_label);
+    StartupCtx *ctx = g_new0(StartupCtx, 1);
+    ctx->widgets = widgets;
+    ctx->main_box = main_box;
+    ctx->startup_area = widgets->main_area;
+    ctx->stage = STARTUP_STAGE_CSS;
+    g_object_set_data_full(G_OBJECT(window), "startup_ctx", ctx, startup_ctx_free);
+    g_signal_connect(window, "map", G_CALLBACK(on_window_map), NULL);
 
     gtk_window_present(GTK_WINDOW(window));
 }
 
+// Options are parsed in the launching process only, so a run that must
+// act on them cannot hand off to an instance that is already running
+static gint
+on_handle_local_options(GApplication *app, GVariantDict *options, gpointer user_data)
+{
+    if (measure_startup || repository_url_option)
+        g_application_set_flags(app, g_application_get_flags(app) | G_APPLICATION_NON_UNIQUE);
+    return -1;
+}
+
 int main(int argc, char **argv)
 {
+    startup_begin_time = g_get_monotonic_time();
+
     GtkApplication *app = gtk_application_new("net.aleritty.ThemeManager", G_APPLICATION_DEFAULT_FLAGS);
+    g_application_add_main_option_entries(G_APPLICATION(app), app_options);
+    g_signal_connect(app, "handle-local-options", G_CALLBACK(on_handle_local_options), NULL);
     g_signal_connect(app, "activate", G_CALLBACK(activate), NULL);
 
     int status = g_application_run(G_APPLICATION(app), argc, argv);
@@ -598,13 +2720,13 @@ int main(int argc, char **argv)
 }
 
 GtkWidget *
-create_theme_metadata_page(const char *theme_name)
+create_theme_metadata_page(const char *theme_name, const char *location)
 {
     GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
     gtk_widget_set_margin_top(box, 12);
     gtk_widget_set_margin_start(box, 12);
 
-    gchar *theme_dir = g_build_filename(g_get_home_dir(), ".themes", theme_name, NULL);
+    gchar *theme_dir = g_build_filename(location, theme_name, NULL);
     gchar *index_file = g_build_filename(theme_dir, "index.theme", NULL);
 
     GKeyFile *key_file = g_key_file_new();
@@ -639,6 +2761,12 @@ create_theme_metadata_page(const char *theme_name)
     GtkWidget *preview = create_theme_preview_widget();
     gtk_box_append(GTK_BOX(box), preview);
 
+    // Drawn from the cache; a sidebar scan still in progress redraws it
+    GtkWidget *swatches = create_palette_swatches(theme_dir, 20);
+    gtk_widget_set_margin_top(swatches, 8);
+    gtk_box_append(GTK_BOX(box), swatches);
+    g_object_set_data(G_OBJECT(box), "palette_swatches", swatches);
+
     // --- BUTTON BAR: Set Theme + Delete Theme ---
     GtkWidget *button_bar = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
     gtk_widget_set_margin_top(button_bar, 12);